@@ -0,0 +1,265 @@
+#include "pch.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "FlatAst.h"
+#include "Optimizer.h"
+#include "Visitor.h"
+#include "ProgramGenerator.h"
+
+#include <atomic>
+#include <chrono>
+#include <new>
+
+// Front end throughput benchmarks.
+//
+// Usage: PyParser3Bench [--shape deep|functions|classes|flat] [--units N] [--reps N]
+//
+// Prints one JSON object per line and measurement, so results can be
+// collected and compared between builds.
+
+
+// Allocation counting
+
+static std::atomic<size_t> allocCount{ 0 };
+static std::atomic<size_t> allocBytes{ 0 };
+
+// Kept out of line, otherwise GCC sees the malloc and free behind them at
+// each new and delete and warns that they don't match
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+BENCH_NOINLINE void* operator new(size_t size) {
+	allocCount.fetch_add(1, std::memory_order_relaxed);
+	allocBytes.fetch_add(size, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+	throw std::bad_alloc{};
+}
+
+BENCH_NOINLINE void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete(void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+struct AllocStats {
+	size_t count;
+	size_t bytes;
+
+	static AllocStats now() {
+		return { allocCount.load(), allocBytes.load() };
+	}
+
+	AllocStats operator-(const AllocStats& other) const {
+		return { count - other.count, bytes - other.bytes };
+	}
+};
+
+
+// Measurement
+
+struct Options {
+	std::vector<ProgramGenerator::Shape> shapes{ ProgramGenerator::shapes.begin(), ProgramGenerator::shapes.end() };
+	size_t units = 0;
+	size_t reps = 5;
+};
+
+// Scales each shape to a few MB of source
+static size_t defaultUnits(ProgramGenerator::Shape shape) {
+	switch (shape) {
+	case ProgramGenerator::Shape::DeepNesting: return 20000;
+	case ProgramGenerator::Shape::ManyFunctions: return 50000;
+	case ProgramGenerator::Shape::LargeClasses: return 50000;
+	case ProgramGenerator::Shape::FlatStatements: return 200000;
+	}
+	return 10000;
+}
+
+using Clock = std::chrono::steady_clock;
+
+// Median wall time of `reps` runs of `run`, in seconds
+template<typename F>
+static double timeMedian(size_t reps, F run) {
+	std::vector<double> times;
+	for (size_t i = 0; i < reps; i++) {
+		auto start = Clock::now();
+		run();
+		times.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+static void report(const char* bench, const char* mode, ProgramGenerator::Shape shape, size_t units,
+	std::initializer_list<std::pair<const char*, double>> fields) {
+	std::string line = fmt::format("{{\"bench\":\"{}\",\"mode\":\"{}\",\"shape\":\"{}\",\"units\":{}",
+		bench, mode, ProgramGenerator::name(shape), units);
+	for (auto& [key, value] : fields) {
+		line += fmt::format(",\"{}\":{}", key, value);
+	}
+	line += "}";
+	std::cout << line << std::endl;
+}
+
+static void benchLexer(ProgramGenerator::Shape shape, size_t units, const std::string& source, size_t reps) {
+	size_t tokenCount = Lexer::fromSource(source).getTokens().size();
+	double bytes = (double)source.size();
+
+	double batch = timeMedian(reps, [&] { Lexer::fromSource(source, Lexer::Mode::Batch); });
+	report("lexer", "batch", shape, units, {
+		{ "bytes", bytes }, { "tokens", (double)tokenCount }, { "seconds", batch },
+		{ "bytes_per_sec", bytes / batch }, { "tokens_per_sec", tokenCount / batch } });
+
+	double stream = timeMedian(reps, [&] {
+		Lexer lexer = Lexer::fromSource(source, Lexer::Mode::Stream);
+		while (lexer.nextToken().type != Token::Type::END) {}
+	});
+	report("lexer", "stream", shape, units, {
+		{ "bytes", bytes }, { "tokens", (double)tokenCount }, { "seconds", stream },
+		{ "bytes_per_sec", bytes / stream }, { "tokens_per_sec", tokenCount / stream } });
+
+	double parallel = timeMedian(reps, [&] { Lexer::fromSource(source, Lexer::Mode::Parallel); });
+	report("lexer", "parallel", shape, units, {
+		{ "bytes", bytes }, { "tokens", (double)tokenCount }, { "seconds", parallel },
+		{ "bytes_per_sec", bytes / parallel }, { "tokens_per_sec", tokenCount / parallel },
+		{ "threads", (double)ThreadPool::shared().size() } });
+}
+
+// Changes one digit in the middle of the source, then compares a full lex
+// and parse of the result with an incremental reparse
+static void benchReparse(ProgramGenerator::Shape shape, size_t units, const std::string& source, size_t reps) {
+	size_t offset = source.size() / 2;
+	while (offset < source.size() && !std::isdigit((unsigned char)source[offset])) offset++;
+	if (offset == source.size()) return;
+	std::string edited = source;
+	edited[offset] = edited[offset] == '7' ? '8' : '7';
+	SourceEdit edit{ offset, 1, 1 };
+
+	double full = timeMedian(reps, [&] { Parser{ Lexer::fromSource(edited).takeTokens() }; });
+
+	std::vector<double> times;
+	size_t reparsed = 0;
+	for (size_t i = 0; i < reps; i++) {
+		std::unique_ptr<Program> previous = Parser{ Lexer::fromSource(source).takeTokens() }.takeProgram();
+		auto start = Clock::now();
+		ReparseResult result = Parser::reparse(std::move(previous), source, edited, edit);
+		times.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+		reparsed = result.reparsed;
+	}
+	std::sort(times.begin(), times.end());
+	double incremental = times[times.size() / 2];
+	report("parser", "incremental", shape, units, {
+		{ "full_seconds", full }, { "seconds", incremental }, { "speedup", full / incremental },
+		{ "reparsed_statements", (double)reparsed } });
+}
+
+// Each run optimizes a freshly parsed program, only the passes are timed
+static void benchOptimizer(ProgramGenerator::Shape shape, size_t units, const std::vector<Token>& tokens,
+	size_t nodes, size_t reps) {
+	std::vector<double> times;
+	Optimizer::Stats stats;
+	for (size_t i = 0; i < reps; i++) {
+		std::unique_ptr<Program> program = Parser{ std::vector<Token>(tokens) }.takeProgram();
+		auto start = Clock::now();
+		stats = Optimizer{}.run(*program);
+		times.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+	}
+	std::sort(times.begin(), times.end());
+	double seconds = times[times.size() / 2];
+	report("optimizer", "all", shape, units, {
+		{ "nodes", (double)nodes }, { "seconds", seconds }, { "nodes_per_sec", nodes / seconds },
+		{ "inlined_calls", (double)stats.inlinedCalls }, { "folded_nodes", (double)stats.foldedNodes }, { "dead_nodes", (double)stats.deadNodes }, { "removed_nodes", (double)stats.removedNodes() },
+		{ "hoisted_expressions", (double)stats.hoistedExpressions } });
+}
+
+static void benchParser(ProgramGenerator::Shape shape, size_t units, const std::string& source, size_t reps) {
+	Lexer lexer = Lexer::fromSource(source);
+	const std::vector<Token>& tokens = lexer.getTokens();
+
+	size_t nodes = 0;
+	AllocStats allocs{};
+	double seconds = timeMedian(reps, [&] {
+		std::vector<Token> copy = tokens;
+		AllocStats before = AllocStats::now();
+		Parser parser{ std::move(copy) };
+		allocs = AllocStats::now() - before;
+		nodes = 0;
+		for (Stmt* stmt : parser.getStatements()) nodes += NodeCounter::count(stmt);
+	});
+	report("parser", "batch", shape, units, {
+		{ "tokens", (double)tokens.size() }, { "nodes", (double)nodes }, { "seconds", seconds },
+		{ "nodes_per_sec", nodes / seconds }, { "tokens_per_sec", tokens.size() / seconds },
+		{ "allocs", (double)allocs.count }, { "alloc_bytes", (double)allocs.bytes },
+		{ "allocs_per_node", (double)allocs.count / std::max<size_t>(1, nodes) } });
+
+	double parallel = timeMedian(reps, [&] { Parser{ std::vector<Token>(tokens), Parser::Mode::Parallel }; });
+	report("parser", "parallel", shape, units, {
+		{ "tokens", (double)tokens.size() }, { "nodes", (double)nodes }, { "seconds", parallel },
+		{ "nodes_per_sec", nodes / parallel }, { "tokens_per_sec", tokens.size() / parallel },
+		{ "threads", (double)ThreadPool::shared().size() } });
+
+	size_t eagerBytes = Parser{ std::vector<Token>(tokens) }.takeProgram()->arena.bytesAllocated();
+	size_t lazyBytes = 0;
+	double lazy = timeMedian(reps, [&] {
+		Parser parser{ std::vector<Token>(tokens), Parser::Mode::Batch, Parser::Bodies::Lazy };
+		lazyBytes = parser.takeProgram()->arena.bytesAllocated();
+	});
+	report("parser", "lazy", shape, units, {
+		{ "tokens", (double)tokens.size() }, { "seconds", lazy }, { "eager_seconds", seconds },
+		{ "tokens_per_sec", tokens.size() / lazy }, { "arena_bytes", (double)lazyBytes },
+		{ "eager_arena_bytes", (double)eagerBytes } });
+
+	benchReparse(shape, units, source, reps);
+
+	benchOptimizer(shape, units, tokens, nodes, reps);
+
+	std::unique_ptr<Program> program = Parser{ std::vector<Token>(tokens) }.takeProgram();
+	double flatten = timeMedian(reps, [&] { FlatAst::build(program->statements); });
+	report("parser", "flatten", shape, units, {
+		{ "nodes", (double)nodes }, { "seconds", flatten }, { "nodes_per_sec", nodes / flatten } });
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--shape" && hasValue) {
+			ProgramGenerator::Shape shape;
+			if (!ProgramGenerator::parse(argv[++i], shape)) {
+				ERR("Unknown shape {}", argv[i]);
+				return false;
+			}
+			options.shapes = { shape };
+		}
+		else if (arg == "--units" && hasValue) {
+			options.units = std::stoul(argv[++i]);
+		}
+		else if (arg == "--reps" && hasValue) {
+			options.reps = std::max<size_t>(1, std::stoul(argv[++i]));
+		}
+		else {
+			ERR("Usage: PyParser3Bench [--shape deep|functions|classes|flat] [--units N] [--reps N]");
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	spdlog::set_pattern("[%^%l%$] %v");
+	spdlog::set_level(spdlog::level::warn);
+
+	Options options;
+	if (!parseOptions(argc, argv, options)) return 1;
+
+	for (ProgramGenerator::Shape shape : options.shapes) {
+		size_t units = options.units ? options.units : defaultUnits(shape);
+		std::string source = ProgramGenerator::generate(shape, units);
+		benchLexer(shape, units, source, options.reps);
+		benchParser(shape, units, source, options.reps);
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include "pch.h"
+
+
+// Builds synthetic scripts of a given shape for the front end benchmarks.
+// `units` scales the program: statements, functions, methods or nesting
+// levels depending on the shape. Output is deterministic.
+class ProgramGenerator {
+public:
+	enum class Shape {
+		// Statements made of deeply parenthesized arithmetic
+		DeepNesting,
+		// Many small top level functions
+		ManyFunctions,
+		// A few classes with many methods each
+		LargeClasses,
+		// One long list of assignments and prints
+		FlatStatements,
+	};
+
+	static constexpr std::array<Shape, 4> shapes = {
+		Shape::DeepNesting,
+		Shape::ManyFunctions,
+		Shape::LargeClasses,
+		Shape::FlatStatements,
+	};
+
+	static const char* name(Shape shape) {
+		switch (shape) {
+		case Shape::DeepNesting: return "deep";
+		case Shape::ManyFunctions: return "functions";
+		case Shape::LargeClasses: return "classes";
+		case Shape::FlatStatements: return "flat";
+		}
+		return "unknown";
+	}
+
+	static bool parse(std::string_view text, Shape& shape) {
+		for (Shape candidate : shapes) {
+			if (text == name(candidate)) {
+				shape = candidate;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static std::string generate(Shape shape, size_t units) {
+		std::string out;
+		switch (shape) {
+		case Shape::DeepNesting:
+			deepNesting(out, units);
+			break;
+		case Shape::ManyFunctions:
+			manyFunctions(out, units);
+			break;
+		case Shape::LargeClasses:
+			largeClasses(out, units);
+			break;
+		case Shape::FlatStatements:
+			flatStatements(out, units);
+			break;
+		}
+		return out;
+	}
+
+private:
+	static constexpr size_t NestingDepth = 32;
+	static constexpr size_t MethodsPerClass = 64;
+
+	static const char* oper(size_t i) {
+		static const char* opers[] = { "+", "-", "*", "/" };
+		return opers[i % 4];
+	}
+
+	static void deepNesting(std::string& out, size_t units) {
+		for (size_t i = 0; i < units; i++) {
+			out += "v" + std::to_string(i) + " = ";
+			for (size_t depth = 0; depth < NestingDepth; depth++) out += "(";
+			out += "1";
+			for (size_t depth = 0; depth < NestingDepth; depth++) {
+				out += std::string(" ") + oper(i + depth) + " " + std::to_string(depth + 2) + ")";
+			}
+			out += ";\n";
+		}
+	}
+
+	static void manyFunctions(std::string& out, size_t units) {
+		for (size_t i = 0; i < units; i++) {
+			std::string id = std::to_string(i);
+			out += "fun f" + id + "(a, b) {\n";
+			out += "\tc = a * b + " + id + ";\n";
+			out += "\tif (c > 10) {\n\t\treturn c - a;\n\t}\n";
+			out += "\treturn c;\n}\n";
+		}
+		for (size_t i = 0; i < units; i += 16) {
+			out += "print f" + std::to_string(i) + "(2, 3);\n";
+		}
+	}
+
+	static void largeClasses(std::string& out, size_t units) {
+		size_t classes = std::max<size_t>(1, units / MethodsPerClass);
+		for (size_t c = 0; c < classes; c++) {
+			std::string cls = "C" + std::to_string(c);
+			out += "class " + cls + " {\n";
+			out += "\tfun init(x) {\n\t\tself.x = x;\n\t}\n";
+			for (size_t m = 0; m < MethodsPerClass; m++) {
+				std::string id = std::to_string(m);
+				out += "\tfun m" + id + "(a) {\n";
+				out += "\t\tself.x = self.x " + std::string(oper(m)) + " a;\n";
+				out += "\t\treturn self.x;\n\t}\n";
+			}
+			out += "}\n";
+			out += "o" + std::to_string(c) + " = " + cls + "(" + std::to_string(c) + ");\n";
+		}
+	}
+
+	static void flatStatements(std::string& out, size_t units) {
+		out += "x0 = 0;\n";
+		for (size_t i = 1; i < units; i++) {
+			std::string id = std::to_string(i);
+			out += "x" + id + " = x" + std::to_string(i - 1) + " " + oper(i) + " " + id + ";\n";
+			if (i % 8 == 0) {
+				out += "print x" + id + ";\n";
+			}
+		}
+	}
+};
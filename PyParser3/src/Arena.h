@@ -0,0 +1,79 @@
+#pragma once
+#include "pch.h"
+
+
+// Fixed size run of items living in an Arena
+template<typename T>
+struct NodeList {
+	T* items = nullptr;
+	size_t count = 0;
+
+	T* begin() const { return items; }
+	T* end() const { return items + count; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	T& operator[](size_t i) const { return items[i]; }
+};
+
+
+// Bump allocator. Memory is handed out in order from large blocks and only
+// released, all at once, when the arena is destroyed. Destructors of the
+// objects it holds are never run, so they must be trivially destructible.
+class Arena {
+public:
+	Arena(size_t _blockSize = 64 * 1024)
+		: blockSize(_blockSize) {}
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	void* allocate(size_t size, size_t align) {
+		size_t start = (used + align - 1) & ~(align - 1);
+		if (blocks.empty() || start + size > capacity) {
+			grow(size + align);
+			start = (used + align - 1) & ~(align - 1);
+		}
+		used = start + size;
+		allocated += size;
+		return current + start;
+	}
+
+	template<typename T, typename... Args>
+	T* make(Args&&... args) {
+		static_assert(std::is_trivially_destructible_v<T>, "Arena objects are never destroyed");
+		return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	template<typename T>
+	NodeList<T> list(const T* items, size_t count) {
+		static_assert(std::is_trivially_copyable_v<T>, "Arena lists are copied bytewise");
+		if (count == 0) return {};
+		T* copy = (T*)allocate(sizeof(T) * count, alignof(T));
+		std::memcpy((void*)copy, items, sizeof(T) * count);
+		return { copy, count };
+	}
+
+	size_t bytesAllocated() const {
+		return allocated;
+	}
+
+	size_t blockCount() const {
+		return blocks.size();
+	}
+
+private:
+	void grow(size_t minimum) {
+		capacity = std::max(blockSize, minimum);
+		// Not value initialized, unlike make_unique
+		blocks.push_back(std::unique_ptr<char[]>(new char[capacity]));
+		current = blocks.back().get();
+		used = 0;
+	}
+
+	size_t blockSize;
+	std::vector<std::unique_ptr<char[]>> blocks;
+	char* current = nullptr;
+	size_t used = 0;
+	size_t capacity = 0;
+	size_t allocated = 0;
+};
@@ -0,0 +1,364 @@
+#pragma once
+#include "pch.h"
+#include "Expression.h"
+#include "Statement.h"
+#include "Object.h"
+#include "Parser.h"
+#include "Resolver.h"
+#include "Visitor.h"
+
+
+// Instructions of the VM. Each is one byte, followed by its operands as
+// 32 bit words. The list is kept in one place so the VM's dispatch table
+// stays in the same order.
+#define BYTECODE_OPS(X) \
+	X(Const)        /* constant -> value */ \
+	X(Nil)          /* -> a new nil */ \
+	X(LoadSlot)     /* slot, symbol -> value */ \
+	X(LoadGlobal)   /* symbol -> value */ \
+	X(LoadName)     /* symbol -> value */ \
+	X(StoreSlot)    /* slot, symbol; value -> value */ \
+	X(StoreGlobal)  /* symbol; value -> value */ \
+	X(StoreName)    /* symbol; value -> value */ \
+	X(GetAttr)      /* symbol; object -> value */ \
+	X(SetAttr)      /* symbol; value, object -> value */ \
+	X(Add) X(Sub) X(Mul) X(Div) \
+	X(Equal) X(NotEqual) X(Less) X(LessEqual) X(Greater) X(GreaterEqual) \
+	X(Binary)       /* operator; left, right -> value */ \
+	X(Negate) X(Not) \
+	X(Call)         /* count; arguments..., callee -> result */ \
+	X(Pop) \
+	X(Print) \
+	X(Jump)         /* target */ \
+	X(JumpIfFalse)  /* target; condition -> */ \
+	X(JumpIfDead)   /* target */ \
+	X(Function)     /* declaration -> function */ \
+	X(Class)        /* declaration -> class */ \
+	X(Define)       /* symbol; value -> */ \
+	X(Return)       /* value -> */ \
+	X(End)
+
+enum class OpCode : uint8_t {
+#define BYTECODE_ENUM(name) name,
+	BYTECODE_OPS(BYTECODE_ENUM)
+#undef BYTECODE_ENUM
+};
+
+
+// Code of the top level statements or of one function body
+struct Chunk {
+	std::vector<uint8_t> code;
+	std::vector<Object*> constants;
+	// Declarations the Function and Class instructions refer to
+	std::vector<Stmt*> decls;
+	// Deepest the operand stack gets while running this chunk alone
+	size_t maxStack = 0;
+
+	uint32_t operand(size_t at) const {
+		uint32_t value;
+		std::memcpy(&value, &code[at], sizeof(value));
+		return value;
+	}
+};
+
+
+// Compiles statements to a Chunk. Runs the same steps the Interpreter
+// takes, in the same order, with names resolved the way the Resolver left
+// them.
+//
+// A return only marks the frame dead, the Interpreter keeps evaluating
+// loop conditions and skips what is left of each block. The compiler
+// tracks whether a return may have run yet and only then checks the
+// frame before each statement of a block.
+class Compiler : public ExprVisitor<Compiler>, public StmtVisitor<Compiler> {
+	friend ExprVisitor<Compiler>;
+	friend StmtVisitor<Compiler>;
+public:
+	static std::unique_ptr<Chunk> compile(const std::vector<Stmt*>& statements) {
+		Compiler compiler;
+		for (Stmt* stmt : statements) compiler.statement(stmt);
+		return compiler.finish();
+	}
+
+	// The body of `func`, parsed and resolved first when it was skipped lazily
+	static std::unique_ptr<Chunk> compile(FuncDeclStmt* func) {
+		if (func->lazy) {
+			Parser::body(func);
+			Resolver::resolve(func);
+		}
+		Compiler compiler;
+		compiler.statement(func->body);
+		return compiler.finish();
+	}
+
+private:
+	Compiler()
+		: chunk(std::make_unique<Chunk>()) {}
+
+	std::unique_ptr<Chunk> finish() {
+		emit(OpCode::End);
+		chunk->maxStack = maxDepth;
+		return std::move(chunk);
+	}
+
+	void statement(Stmt* stmt) {
+		if (stmt) StmtVisitor::visit(stmt);
+	}
+
+	void expression(Expr* expr) {
+		if (expr) {
+			ExprVisitor::visit(expr);
+			return;
+		}
+		// The Interpreter has nothing to evaluate either, keep the stack even
+		emit(OpCode::Nil);
+		push();
+	}
+
+	// Statements
+
+	void visitBlock(BlockStmt* stmt) {
+		std::vector<size_t> exits;
+		for (Stmt* inner : stmt->stmts) {
+			if (mayBeDead) exits.push_back(jump(OpCode::JumpIfDead));
+			statement(inner);
+		}
+		for (size_t exit : exits) patch(exit);
+	}
+
+	void visitExpression(ExprStmt* stmt) {
+		expression(stmt->expr);
+		emit(OpCode::Pop);
+		pop();
+	}
+
+	void visitPrint(PrintStmt* stmt) {
+		expression(stmt->expr);
+		emit(OpCode::Print);
+		pop();
+	}
+
+	void visitIf(IfStmt* stmt) {
+		expression(stmt->condition);
+		size_t toElse = jump(OpCode::JumpIfFalse);
+		pop();
+		bool deadBefore = mayBeDead;
+		statement(stmt->thenStmt);
+		bool deadThen = mayBeDead;
+		if (!stmt->elseStmt) {
+			patch(toElse);
+			return;
+		}
+		size_t toEnd = jump(OpCode::Jump);
+		patch(toElse);
+		mayBeDead = deadBefore;
+		statement(stmt->elseStmt);
+		mayBeDead = mayBeDead || deadThen;
+		patch(toEnd);
+	}
+
+	void visitWhile(WhileStmt* stmt) {
+		// A return in one iteration leaves the next one dead
+		if (Returns::in(stmt->main)) mayBeDead = true;
+		size_t top = chunk->code.size();
+		expression(stmt->condition);
+		size_t toEnd = jump(OpCode::JumpIfFalse);
+		pop();
+		statement(stmt->main);
+		emit(OpCode::Jump);
+		emit32((uint32_t)top);
+		patch(toEnd);
+	}
+
+	void visitFuncDecl(FuncDeclStmt* stmt) {
+		declare(OpCode::Function, stmt, stmt->name.symbol);
+	}
+
+	void visitClassDecl(ClassDeclStmt* stmt) {
+		declare(OpCode::Class, stmt, stmt->name.symbol);
+	}
+
+	void visitReturn(ReturnStmt* stmt) {
+		if (stmt->retVal) {
+			expression(stmt->retVal);
+		}
+		else {
+			emit(OpCode::Nil);
+			push();
+		}
+		emit(OpCode::Return);
+		pop();
+		mayBeDead = true;
+	}
+
+	void declare(OpCode op, Stmt* decl, Symbol name) {
+		emit(op);
+		emit32((uint32_t)chunk->decls.size());
+		chunk->decls.push_back(decl);
+		push();
+		emit(OpCode::Define);
+		emit32(name);
+		pop();
+	}
+
+	// Expressions
+
+	void visitLiteral(LiteralExpr* expr) {
+		emit(OpCode::Const);
+		emit32(constant(expr->value));
+		push();
+	}
+
+	void visitIdentifier(IdentifierExpr* expr) {
+		name(expr, OpCode::LoadSlot, OpCode::LoadGlobal, OpCode::LoadName);
+		push();
+	}
+
+	void visitUnary(UnaryExpr* expr) {
+		expression(expr->right);
+		emit(expr->oper.type == Token::Type::MINUS ? OpCode::Negate : OpCode::Not);
+	}
+
+	void visitBinary(BinaryExpr* expr) {
+		expression(expr->left);
+		expression(expr->right);
+		switch (expr->oper.type) {
+		case Token::Type::PLUS: emit(OpCode::Add); break;
+		case Token::Type::MINUS: emit(OpCode::Sub); break;
+		case Token::Type::STAR: emit(OpCode::Mul); break;
+		case Token::Type::DIV: emit(OpCode::Div); break;
+		case Token::Type::EQUAL_EQUAL: emit(OpCode::Equal); break;
+		case Token::Type::BANG_EQUAL: emit(OpCode::NotEqual); break;
+		case Token::Type::LESS: emit(OpCode::Less); break;
+		case Token::Type::LESS_EQUAL: emit(OpCode::LessEqual); break;
+		case Token::Type::GREAT: emit(OpCode::Greater); break;
+		case Token::Type::GREAT_EQUAL: emit(OpCode::GreaterEqual); break;
+		default:
+			emit(OpCode::Binary);
+			emit32((uint32_t)expr->oper.type);
+			break;
+		}
+		pop();
+	}
+
+	void visitAssign(AssignExpr* expr) {
+		expression(expr->value);
+		Expr* target = expr->left;
+		if (target && target->type == ExprType::Identifier) {
+			name((IdentifierExpr*)target, OpCode::StoreSlot, OpCode::StoreGlobal, OpCode::StoreName);
+			return;
+		}
+		if (target && target->type == ExprType::Get) {
+			GetExpr* get = (GetExpr*)target;
+			expression(get->left);
+			emit(OpCode::SetAttr);
+			emit32(get->right.symbol);
+			pop();
+			return;
+		}
+		ERR("Illegal Reference");
+	}
+
+	void visitFuncCall(FuncCallExpr* expr) {
+		// Arguments are evaluated before the callee
+		for (Expr* arg : expr->args) expression(arg);
+		expression(expr->name);
+		emit(OpCode::Call);
+		emit32((uint32_t)expr->args.size());
+		pop(expr->args.size());
+	}
+
+	void visitGet(GetExpr* expr) {
+		expression(expr->left);
+		emit(OpCode::GetAttr);
+		emit32(expr->right.symbol);
+	}
+
+	// Emits the instruction for where the Resolver placed `expr`
+	void name(IdentifierExpr* expr, OpCode slot, OpCode global, OpCode dynamic) {
+		switch (expr->scope) {
+		case Scope::Frame:
+			emit(slot);
+			emit32(expr->slot);
+			break;
+		case Scope::Global:
+			emit(global);
+			break;
+		default:
+			emit(dynamic);
+			break;
+		}
+		emit32(expr->token.symbol);
+	}
+
+	// Helpers
+
+	// Whether a statement returns from the frame it runs in
+	struct Returns : public TreeWalker<Returns> {
+		bool found = false;
+
+		static bool in(Stmt* stmt) {
+			Returns returns;
+			returns.visit(stmt);
+			return returns.found;
+		}
+
+		void visitReturn(ReturnStmt*) {
+			found = true;
+		}
+
+		// Expressions cannot hold statements, nor do bodies run here
+		void visit(Expr*) {}
+		using TreeWalker::visit;
+		void visitFuncDecl(FuncDeclStmt*) {}
+		void visitClassDecl(ClassDeclStmt*) {}
+	};
+
+	void emit(OpCode op) {
+		chunk->code.push_back((uint8_t)op);
+	}
+
+	void emit32(uint32_t value) {
+		size_t at = chunk->code.size();
+		chunk->code.resize(at + sizeof(value));
+		std::memcpy(&chunk->code[at], &value, sizeof(value));
+	}
+
+	// Emits a jump to be patched, returns where its target goes
+	size_t jump(OpCode op) {
+		emit(op);
+		emit32(0);
+		return chunk->code.size() - sizeof(uint32_t);
+	}
+
+	// Points the jump at `at` to the next instruction
+	void patch(size_t at) {
+		uint32_t target = (uint32_t)chunk->code.size();
+		std::memcpy(&chunk->code[at], &target, sizeof(target));
+	}
+
+	uint32_t constant(Object* value) {
+		auto it = constantIndex.find(value);
+		if (it != constantIndex.end()) return it->second;
+		uint32_t index = (uint32_t)chunk->constants.size();
+		chunk->constants.push_back(value);
+		constantIndex.emplace(value, index);
+		return index;
+	}
+
+	void push() {
+		depth++;
+		maxDepth = std::max(maxDepth, depth);
+	}
+
+	void pop(size_t count = 1) {
+		depth -= count;
+	}
+
+	std::unique_ptr<Chunk> chunk;
+	std::unordered_map<Object*, uint32_t> constantIndex;
+	size_t depth = 0;
+	size_t maxDepth = 0;
+	// Whether a return may have run in the frame by this point
+	bool mayBeDead = false;
+};
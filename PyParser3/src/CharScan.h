@@ -0,0 +1,256 @@
+#pragma once
+#include "pch.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+	#define CHARSCAN_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+	#define CHARSCAN_AVX2_TARGET __attribute__((target("avx2")))
+#else
+	#define CHARSCAN_AVX2_TARGET
+#endif
+
+
+// Vectorized scanning of character runs for the Lexer.
+// Each skip function returns the first position in [p, end) whose character
+// is not part of the run. The widest implementation the CPU supports is
+// picked the first time it is used; all of them give identical results.
+class CharScan {
+public:
+	enum class Level {
+		Scalar,
+		SSE2,
+		AVX2,
+	};
+
+	// ' ', '\t', '\r', '\n'
+	static const char* skipWhitespace(const char* p, const char* end) {
+		return impl().whitespace(p, end);
+	}
+
+	// [A-Za-z0-9_]
+	static const char* skipIdentifier(const char* p, const char* end) {
+		return impl().identifier(p, end);
+	}
+
+	// [0-9]
+	static const char* skipDigits(const char* p, const char* end) {
+		return impl().digits(p, end);
+	}
+
+	static Level level() {
+		return impl().level;
+	}
+
+	// Forces an implementation, e.g. to compare against the scalar path.
+	// Levels the CPU does not support are clamped to the best available one.
+	static void use(Level level) {
+		impl() = select(std::min(level, detect()));
+	}
+
+	static const char* name(Level level) {
+		switch (level) {
+		case Level::AVX2: return "AVX2";
+		case Level::SSE2: return "SSE2";
+		default: return "Scalar";
+		}
+	}
+
+private:
+	using SkipFn = const char* (*)(const char*, const char*);
+
+	struct Impl {
+		Level level;
+		SkipFn whitespace;
+		SkipFn identifier;
+		SkipFn digits;
+	};
+
+	static Impl& impl() {
+		static Impl current = select(detect());
+		return current;
+	}
+
+	static Impl select(Level level) {
+#ifdef CHARSCAN_X86
+		if (level == Level::AVX2)
+			return { Level::AVX2, whitespaceAVX2, identifierAVX2, digitsAVX2 };
+		if (level == Level::SSE2)
+			return { Level::SSE2, whitespaceSSE2, identifierSSE2, digitsSSE2 };
+#endif
+		return { Level::Scalar, whitespaceScalar, identifierScalar, digitsScalar };
+	}
+
+	static Level detect() {
+#ifdef CHARSCAN_X86
+	#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] >= 7) {
+			__cpuid(info, 1);
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			bool avxState = osxsave && (_xgetbv(0) & 0x6) == 0x6;
+			__cpuidex(info, 7, 0);
+			if (avxState && (info[1] & (1 << 5))) return Level::AVX2;
+		}
+		return Level::SSE2;
+	#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) return Level::AVX2;
+		return Level::SSE2;
+	#endif
+#endif
+		return Level::Scalar;
+	}
+
+	// Scalar
+
+	static bool isWhitespace(char chr) {
+		return chr == ' ' || chr == '\t' || chr == '\r' || chr == '\n';
+	}
+
+	static bool isDigit(char chr) {
+		return chr >= '0' && chr <= '9';
+	}
+
+	static bool isIdentifier(char chr) {
+		return (chr >= 'A' && chr <= 'Z') || (chr >= 'a' && chr <= 'z') || chr == '_' || isDigit(chr);
+	}
+
+	static const char* whitespaceScalar(const char* p, const char* end) {
+		while (p < end && isWhitespace(*p)) p++;
+		return p;
+	}
+
+	static const char* identifierScalar(const char* p, const char* end) {
+		while (p < end && isIdentifier(*p)) p++;
+		return p;
+	}
+
+	static const char* digitsScalar(const char* p, const char* end) {
+		while (p < end && isDigit(*p)) p++;
+		return p;
+	}
+
+#ifdef CHARSCAN_X86
+	static unsigned firstSetBit(uint32_t mask) {
+	#if defined(_MSC_VER) && !defined(__clang__)
+		unsigned long bit;
+		_BitScanForward(&bit, mask);
+		return bit;
+	#else
+		return __builtin_ctz(mask);
+	#endif
+	}
+
+	// SSE2, 16 bytes per step
+
+	static __m128i whitespaceMask(__m128i chunk) {
+		__m128i space = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '));
+		__m128i tab = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'));
+		__m128i cr = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'));
+		__m128i lf = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'));
+		return _mm_or_si128(_mm_or_si128(space, tab), _mm_or_si128(cr, lf));
+	}
+
+	static __m128i digitMask(__m128i chunk) {
+		// Bytes >= 0x80 compare as negative and fall out of the range
+		__m128i low = _mm_cmpgt_epi8(chunk, _mm_set1_epi8('0' - 1));
+		__m128i high = _mm_cmplt_epi8(chunk, _mm_set1_epi8('9' + 1));
+		return _mm_and_si128(low, high);
+	}
+
+	static __m128i identifierMask(__m128i chunk) {
+		// Setting bit 5 folds 'A'-'Z' onto 'a'-'z' without pulling in anything else
+		__m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+		__m128i alpha = _mm_and_si128(
+			_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+			_mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+		__m128i underscore = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_'));
+		return _mm_or_si128(_mm_or_si128(alpha, underscore), digitMask(chunk));
+	}
+
+	template<__m128i (*Mask)(__m128i), SkipFn Tail>
+	static const char* skipSSE2(const char* p, const char* end) {
+		while (end - p >= 16) {
+			__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+			uint32_t outside = ~(uint32_t)_mm_movemask_epi8(Mask(chunk)) & 0xFFFF;
+			if (outside) return p + firstSetBit(outside);
+			p += 16;
+		}
+		return Tail(p, end);
+	}
+
+	static const char* whitespaceSSE2(const char* p, const char* end) {
+		return skipSSE2<whitespaceMask, whitespaceScalar>(p, end);
+	}
+
+	static const char* identifierSSE2(const char* p, const char* end) {
+		return skipSSE2<identifierMask, identifierScalar>(p, end);
+	}
+
+	static const char* digitsSSE2(const char* p, const char* end) {
+		return skipSSE2<digitMask, digitsScalar>(p, end);
+	}
+
+	// AVX2, 32 bytes per step, falls back to SSE2 for the remainder
+
+	CHARSCAN_AVX2_TARGET static __m256i whitespaceMask256(__m256i chunk) {
+		__m256i space = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' '));
+		__m256i tab = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'));
+		__m256i cr = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'));
+		__m256i lf = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'));
+		return _mm256_or_si256(_mm256_or_si256(space, tab), _mm256_or_si256(cr, lf));
+	}
+
+	CHARSCAN_AVX2_TARGET static __m256i digitMask256(__m256i chunk) {
+		__m256i low = _mm256_cmpgt_epi8(chunk, _mm256_set1_epi8('0' - 1));
+		__m256i high = _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chunk);
+		return _mm256_and_si256(low, high);
+	}
+
+	CHARSCAN_AVX2_TARGET static __m256i identifierMask256(__m256i chunk) {
+		__m256i lower = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+		__m256i alpha = _mm256_and_si256(
+			_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+			_mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+		__m256i underscore = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('_'));
+		return _mm256_or_si256(_mm256_or_si256(alpha, underscore), digitMask256(chunk));
+	}
+
+	CHARSCAN_AVX2_TARGET static const char* whitespaceAVX2(const char* p, const char* end) {
+		while (end - p >= 32) {
+			__m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+			uint32_t outside = ~(uint32_t)_mm256_movemask_epi8(whitespaceMask256(chunk));
+			if (outside) return p + firstSetBit(outside);
+			p += 32;
+		}
+		return whitespaceSSE2(p, end);
+	}
+
+	CHARSCAN_AVX2_TARGET static const char* identifierAVX2(const char* p, const char* end) {
+		while (end - p >= 32) {
+			__m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+			uint32_t outside = ~(uint32_t)_mm256_movemask_epi8(identifierMask256(chunk));
+			if (outside) return p + firstSetBit(outside);
+			p += 32;
+		}
+		return identifierSSE2(p, end);
+	}
+
+	CHARSCAN_AVX2_TARGET static const char* digitsAVX2(const char* p, const char* end) {
+		while (end - p >= 32) {
+			__m256i chunk = _mm256_loadu_si256((const __m256i*)p);
+			uint32_t outside = ~(uint32_t)_mm256_movemask_epi8(digitMask256(chunk));
+			if (outside) return p + firstSetBit(outside);
+			p += 32;
+		}
+		return digitsSSE2(p, end);
+	}
+#endif
+};
@@ -0,0 +1,321 @@
+#pragma once
+#include "pch.h"
+#include "Expression.h"
+#include "Statement.h"
+#include "Object.h"
+#include "Environment.h"
+#include "Parser.h"
+#include "Resolver.h"
+#include "Interpreter.h"
+#include "Visitor.h"
+
+
+// Runs a program by first turning every node into a callable bound to its
+// children, which then runs without looking at the tree again. The type
+// of each node, its operator and where the Resolver placed its names are
+// decided once, when the callable is made.
+//
+// Same semantics as the Interpreter, over the same Objects and
+// Environments. Function bodies are compiled on their first call.
+class ClosureCompiler : public ExprVisitor<ClosureCompiler, std::function<Object*()>>, public StmtVisitor<ClosureCompiler, std::function<void()>> {
+	friend ExprVisitor<ClosureCompiler, std::function<Object*()>>;
+	friend StmtVisitor<ClosureCompiler, std::function<void()>>;
+public:
+	using Eval = std::function<Object*()>;
+	using Exec = std::function<void()>;
+
+	ClosureCompiler() {
+		env = new Environment{ nullptr };
+	}
+
+	void execute(const std::vector<Stmt*>& statements) {
+		std::vector<Exec> program;
+		for (Stmt* stmt : statements) program.push_back(compile(stmt));
+		INFO("Starting Execution");
+		for (const Exec& stmt : program) stmt();
+	}
+
+	Environment* env;
+
+private:
+	Exec compile(Stmt* stmt) {
+		if (!stmt) return [] {};
+		return StmtVisitor::visit(stmt);
+	}
+
+	Eval compile(Expr* expr) {
+		if (!expr) return []() -> Object* { return new NilObject{}; };
+		return ExprVisitor::visit(expr);
+	}
+
+	// Statements
+
+	Exec visitBlock(BlockStmt* stmt) {
+		std::vector<Exec> stmts;
+		for (Stmt* inner : stmt->stmts) stmts.push_back(compile(inner));
+		return [this, stmts] {
+			for (const Exec& inner : stmts) {
+				if (env->isDead) break;
+				inner();
+			}
+		};
+	}
+
+	Exec visitExpression(ExprStmt* stmt) {
+		Eval expr = compile(stmt->expr);
+		return [expr] { expr(); };
+	}
+
+	Exec visitPrint(PrintStmt* stmt) {
+		Eval expr = compile(stmt->expr);
+		return [expr] { std::cout << number(expr()) << std::endl; };
+	}
+
+	Exec visitIf(IfStmt* stmt) {
+		Eval condition = compile(stmt->condition);
+		Exec thenStmt = compile(stmt->thenStmt);
+		if (!stmt->elseStmt) {
+			return [condition, thenStmt] {
+				if (number(condition())) thenStmt();
+			};
+		}
+		Exec elseStmt = compile(stmt->elseStmt);
+		return [condition, thenStmt, elseStmt] {
+			if (number(condition())) thenStmt();
+			else elseStmt();
+		};
+	}
+
+	Exec visitWhile(WhileStmt* stmt) {
+		Eval condition = compile(stmt->condition);
+		Exec body = compile(stmt->main);
+		return [condition, body] {
+			while (number(condition())) body();
+		};
+	}
+
+	Exec visitFuncDecl(FuncDeclStmt* stmt) {
+		return [this, stmt] { env->setValue(stmt->name.symbol, new FuncObject{ stmt }); };
+	}
+
+	Exec visitClassDecl(ClassDeclStmt* stmt) {
+		return [this, stmt] {
+			ClassObject* cls = new ClassObject{};
+			for (FuncDeclStmt* method : stmt->methods) {
+				cls->addMethod(method->name.symbol, new FuncObject{ method });
+			}
+			env->setValue(stmt->name.symbol, cls);
+		};
+	}
+
+	Exec visitReturn(ReturnStmt* stmt) {
+		Eval value = compile(stmt->retVal);
+		return [this, value] {
+			Object* retVal = value();
+			env->setValueForce(Symbols::Retval, retVal);
+			env->isDead = true;
+		};
+	}
+
+	// Expressions
+
+	Eval visitLiteral(LiteralExpr* expr) {
+		Object* value = expr->value;
+		return [value] { return value; };
+	}
+
+	Eval visitIdentifier(IdentifierExpr* expr) {
+		Symbol name = expr->token.symbol;
+		uint32_t slot = expr->slot;
+		switch (expr->scope) {
+		case Scope::Frame:
+			return [this, slot, name] {
+				Object* value = env->slots[slot];
+				return value ? value : env->getValue(name);
+			};
+		case Scope::Global:
+			return [this, name] {
+				Object* value = name < env->globals.size() ? env->globals[name] : nullptr;
+				return value ? value : env->getValue(name);
+			};
+		default:
+			return [this, name] { return env->getValue(name); };
+		}
+	}
+
+	Eval visitUnary(UnaryExpr* expr) {
+		Eval right = compile(expr->right);
+		if (expr->oper.type == Token::Type::MINUS) {
+			return [right]() -> Object* { return new FloatObject{ -number(right()) }; };
+		}
+		return [right]() -> Object* { return new FloatObject{ number(right()) == 0 ? 1.0f : 0.0f }; };
+	}
+
+	Eval visitBinary(BinaryExpr* expr) {
+		switch (expr->oper.type) {
+		case Token::Type::PLUS: return binary(expr, [](float l, float r) { return l + r; });
+		case Token::Type::MINUS: return binary(expr, [](float l, float r) { return l - r; });
+		case Token::Type::STAR: return binary(expr, [](float l, float r) { return l * r; });
+		case Token::Type::DIV: return binary(expr, [](float l, float r) { return l / r; });
+		case Token::Type::EQUAL_EQUAL: return binary(expr, [](float l, float r) { return l == r ? 1.0f : 0.0f; });
+		case Token::Type::BANG_EQUAL: return binary(expr, [](float l, float r) { return l != r ? 1.0f : 0.0f; });
+		case Token::Type::LESS: return binary(expr, [](float l, float r) { return l < r ? 1.0f : 0.0f; });
+		case Token::Type::LESS_EQUAL: return binary(expr, [](float l, float r) { return l <= r ? 1.0f : 0.0f; });
+		case Token::Type::GREAT: return binary(expr, [](float l, float r) { return l > r ? 1.0f : 0.0f; });
+		case Token::Type::GREAT_EQUAL: return binary(expr, [](float l, float r) { return l >= r ? 1.0f : 0.0f; });
+		default: {
+			Token::Type oper = expr->oper.type;
+			return binary(expr, [oper](float l, float r) { return Interpreter::apply(oper, l, r); });
+		}
+		}
+	}
+
+	// A literal on the right is read once, here, rather than on every run
+	template<typename Op>
+	Eval binary(BinaryExpr* expr, Op op) {
+		Eval left = compile(expr->left);
+		if (expr->right && expr->right->type == ExprType::Literal) {
+			float right = number(((LiteralExpr*)expr->right)->value);
+			return [left, right, op]() -> Object* { return new FloatObject{ op(number(left()), right) }; };
+		}
+		Eval right = compile(expr->right);
+		return [left, right, op]() -> Object* {
+			float l = number(left());
+			return new FloatObject{ op(l, number(right())) };
+		};
+	}
+
+	Eval visitAssign(AssignExpr* expr) {
+		Eval value = compile(expr->value);
+		Expr* target = expr->left;
+		if (target && target->type == ExprType::Identifier) {
+			IdentifierExpr* id = (IdentifierExpr*)target;
+			Symbol name = id->token.symbol;
+			uint32_t slot = id->slot;
+			switch (id->scope) {
+			case Scope::Frame:
+				return [this, value, slot, name] {
+					Object* result = value();
+					Object*& binding = env->slots[slot];
+					if (binding) binding = result;
+					else *env->getRef(name).obj = result;
+					return result;
+				};
+			case Scope::Global:
+				return [this, value, name] {
+					Object* result = value();
+					if (name < env->globals.size() && env->globals[name]) env->globals[name] = result;
+					else *env->getRef(name).obj = result;
+					return result;
+				};
+			default:
+				return [this, value, name] {
+					Object* result = value();
+					*env->getRef(name).obj = result;
+					return result;
+				};
+			}
+		}
+		if (target && target->type == ExprType::Get) {
+			GetExpr* get = (GetExpr*)target;
+			Eval object = compile(get->left);
+			Symbol name = get->right.symbol;
+			return [value, object, name] {
+				Object* result = value();
+				ObjRef ref = object()->getAttrRef(name);
+				if (ref.obj) *ref.obj = result;
+				return result;
+			};
+		}
+		ERR("Illegal Reference");
+		return value;
+	}
+
+	Eval visitFuncCall(FuncCallExpr* expr) {
+		std::vector<Eval> args;
+		for (Expr* arg : expr->args) args.push_back(compile(arg));
+		Eval callee = compile(expr->name);
+		return [this, args, callee] {
+			// Arguments are evaluated before the callee
+			size_t base = arguments.size();
+			for (const Eval& arg : args) arguments.push_back(arg());
+			Object* func = callee();
+			Object* result = call(func, arguments.data() + base, args.size());
+			arguments.resize(base);
+			return result;
+		};
+	}
+
+	Eval visitGet(GetExpr* expr) {
+		Eval object = compile(expr->left);
+		Symbol name = expr->right.symbol;
+		return [object, name] { return object()->getAttr(name); };
+	}
+
+	// Calls
+
+	// Calls `callee` the way its Object::call would
+	Object* call(Object* callee, Object** args, size_t count) {
+		if (!callee) {
+			ERR("Illegal call");
+			return nullptr;
+		}
+		switch (callee->getType()) {
+		case Object::Type::FUNC:
+			return invoke((FuncObject*)callee, args, count);
+		case Object::Type::CLASS: {
+			ObjObject* obj = new ObjObject{ (ClassObject*)callee };
+			Object* init = obj->getAttr(Symbols::Init);
+			if (init) call(init, args, count);
+			return obj;
+		}
+		default:
+			ERR("Illegal call");
+			return nullptr;
+		}
+	}
+
+	// `args` are copied into the frame before anything else runs, so they
+	// may point into `arguments`
+	Object* invoke(FuncObject* func, Object** args, size_t count) {
+		if (func->params.size() != count) {
+			ERR("Argument length not matching");
+		}
+		const Exec& body = compiled(func->decl);
+		Environment* frame = new Environment{ env, func->params };
+		for (size_t i = 0; i < func->params.size() && i < count; i++) {
+			frame->slots[2 + i] = args[i];
+		}
+		frame->slots[Environment::SelfSlot] = func->binding;
+		frame->slots[Environment::RetvalSlot] = new NilObject{};
+
+		env = frame;
+		body();
+		env = frame->parent;
+		return frame->slots[Environment::RetvalSlot];
+	}
+
+	// The body of a function, compiled once however many times it is declared
+	const Exec& compiled(FuncDeclStmt* decl) {
+		Exec& body = functions[decl];
+		if (!body) {
+			if (decl->lazy) {
+				Parser::body(decl);
+				Resolver::resolve(decl);
+			}
+			body = compile((Stmt*)decl->body);
+		}
+		return body;
+	}
+
+	static float number(Object* value) {
+		if (value->getType() == Object::Type::FLOAT) {
+			return ((FloatObject*)value)->value;
+		}
+		return 0;
+	}
+
+	std::unordered_map<FuncDeclStmt*, Exec> functions;
+	// Arguments of the calls being made, innermost last
+	std::vector<Object*> arguments;
+};
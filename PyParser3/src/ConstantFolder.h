@@ -0,0 +1,159 @@
+#pragma once
+#include "pch.h"
+#include "Expression.h"
+#include "Statement.h"
+#include "Program.h"
+#include "Interpreter.h"
+#include "Visitor.h"
+
+
+// Replaces operators on literals with the literal they evaluate to, and
+// drops operations that cannot change a number (x * 1, 1 * x, x / 1,
+// x - 0). Values are computed like the Interpreter computes them, so
+// folding never changes what a script prints.
+//
+// Dropping an operation hands back the operand itself instead of a number
+// made from it, which is only the same where the value is read as a
+// number anyway: operands of operators, conditions, prints and the value
+// of an expression statement. Operands are always kept, along with any
+// calls in them.
+//
+// Nodes are rewritten in place, new literals are allocated in the Program.
+// Bodies still waiting to be parsed lazily are left alone.
+class ConstantFolder : public TreeWalker<ConstantFolder> {
+	friend StmtVisitor<ConstantFolder>;
+public:
+	ConstantFolder(Program& _program)
+		: program(_program) {}
+
+	void run(std::vector<Stmt*>& statements) {
+		visit(statements);
+	}
+
+	// Nodes no longer in the tree
+	size_t removedNodes() const {
+		return removed;
+	}
+
+private:
+	void visitExpression(ExprStmt* stmt) {
+		stmt->expr = fold(stmt->expr, true);
+	}
+
+	void visitPrint(PrintStmt* stmt) {
+		stmt->expr = fold(stmt->expr, true);
+	}
+
+	void visitIf(IfStmt* stmt) {
+		stmt->condition = fold(stmt->condition, true);
+		visit(stmt->thenStmt);
+		visit(stmt->elseStmt);
+	}
+
+	void visitWhile(WhileStmt* stmt) {
+		stmt->condition = fold(stmt->condition, true);
+		visit(stmt->main);
+	}
+
+	void visitReturn(ReturnStmt* stmt) {
+		stmt->retVal = fold(stmt->retVal, false);
+	}
+
+	// An expression after folding. A constant one only becomes a literal
+	// once no enclosing operator can fold it further.
+	struct Folded {
+		Expr* expr;
+		bool constant;
+		float value;
+	};
+
+	// `numeric` when the value is only ever read as a number
+	Expr* fold(Expr* expr, bool numeric) {
+		return materialize(foldValue(expr, numeric));
+	}
+
+	Expr* materialize(Folded folded) {
+		if (!folded.constant || folded.expr->type == ExprType::Literal) return folded.expr;
+		return literal(folded.value);
+	}
+
+	Folded foldValue(Expr* expr, bool numeric) {
+		if (!expr) return { nullptr, false, 0 };
+		switch (expr->type) {
+		case ExprType::Literal:
+			return { expr, true, ((LiteralExpr*)expr)->value->value };
+		case ExprType::Unary:
+			return foldUnary((UnaryExpr*)expr);
+		case ExprType::Binary:
+			return foldBinary((BinaryExpr*)expr, numeric);
+		case ExprType::Assign: {
+			AssignExpr* assign = (AssignExpr*)expr;
+			assign->left = fold(assign->left, false);
+			assign->value = fold(assign->value, false);
+			break;
+		}
+		case ExprType::FuncCall: {
+			FuncCallExpr* call = (FuncCallExpr*)expr;
+			call->name = fold(call->name, false);
+			for (Expr*& arg : call->args) arg = fold(arg, false);
+			break;
+		}
+		case ExprType::Get:
+			((GetExpr*)expr)->left = fold(((GetExpr*)expr)->left, false);
+			break;
+		default:
+			break;
+		}
+		return { expr, false, 0 };
+	}
+
+	Folded foldUnary(UnaryExpr* expr) {
+		Folded right = foldValue(expr->right, true);
+		if (!right.constant) {
+			expr->right = right.expr;
+			return { expr, false, 0 };
+		}
+		removed += 1;
+		return { expr, true, Interpreter::unary(expr->oper.type, right.value) };
+	}
+
+	Folded foldBinary(BinaryExpr* expr, bool numeric) {
+		Folded left = foldValue(expr->left, true);
+		Folded right = foldValue(expr->right, true);
+		Token::Type oper = expr->oper.type;
+		if (left.constant && right.constant) {
+			removed += 2;
+			return { expr, true, Interpreter::apply(oper, left.value, right.value) };
+		}
+		expr->left = materialize(left);
+		expr->right = materialize(right);
+		if (!numeric) return { expr, false, 0 };
+
+		// Only identities that hold for every float, -0 and NaN included
+		bool rightIdentity = right.constant &&
+			((right.value == 1 && (oper == Token::Type::STAR || oper == Token::Type::DIV)) ||
+			(right.value == 0 && !std::signbit(right.value) && oper == Token::Type::MINUS));
+		if (rightIdentity) {
+			removed += 2;
+			return { expr->left, false, 0 };
+		}
+		if (left.constant && left.value == 1 && oper == Token::Type::STAR) {
+			removed += 2;
+			return { expr->right, false, 0 };
+		}
+		return { expr, false, 0 };
+	}
+
+	// A literal for `value`, with its text kept in the arena
+	LiteralExpr* literal(float value) {
+		char text[32];
+		size_t length = (size_t)(std::to_chars(text, text + sizeof(text), value).ptr - text);
+		char* chars = (char*)program.arena.allocate(length, 1);
+		std::memcpy(chars, text, length);
+		Token token{ Token::Type::INTEGER, std::string_view{ chars, length } };
+		return program.arena.make<LiteralExpr>(token, program.constants.get(value));
+	}
+
+	Program& program;
+	size_t removed = 0;
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include "pch.h"
+#include "Object.h"
+
+
+// Number objects for literals, decoded once while parsing instead of every
+// time the literal is evaluated. Equal values share one object, so the
+// objects must never be modified. They live as long as the pool.
+class ConstantPool {
+public:
+	FloatObject* get(float value) {
+		uint32_t key;
+		std::memcpy(&key, &value, sizeof(key));
+		auto it = index.find(key);
+		if (it != index.end()) return it->second;
+
+		FloatObject* constant = &values.emplace_back(value);
+		index.emplace(key, constant);
+		return constant;
+	}
+
+	// Null when `literal` is not an integer
+	FloatObject* decode(std::string_view literal) {
+		int64_t value = 0;
+		auto [end, error] = std::from_chars(literal.data(), literal.data() + literal.size(), value);
+		if (error != std::errc{} || end != literal.data() + literal.size()) {
+			ERR("Invalid integer literal {}", literal);
+			return nullptr;
+		}
+		return get((float)value);
+	}
+
+	size_t size() const {
+		return values.size();
+	}
+
+private:
+	// Deque, so handed out pointers stay valid as the pool grows
+	std::deque<FloatObject> values;
+	std::unordered_map<uint32_t, FloatObject*> index;
+};
@@ -0,0 +1,155 @@
+#pragma once
+#include "pch.h"
+#include "Expression.h"
+#include "Statement.h"
+#include "Program.h"
+#include "Visitor.h"
+
+
+// Removes statements that can never run:
+// - statements in a block after one that always returns
+// - the branch of an if a literal condition never takes, and the if itself
+// - while loops whose condition is a literal false
+// - empty blocks, and ifs left with nothing to run
+//
+// A condition is only constant once it is a literal, so this runs after
+// ConstantFolder. Top level statements are replaced but never removed, so
+// they stay lined up with Program::statementEnds; one with nothing left
+// becomes an empty block. Bodies still waiting on a lazy parse are left
+// alone.
+class DeadCodeEliminator : public StmtVisitor<DeadCodeEliminator, Stmt*> {
+	friend StmtVisitor<DeadCodeEliminator, Stmt*>;
+public:
+	DeadCodeEliminator(Program& _program)
+		: program(_program) {}
+
+	void run(std::vector<Stmt*>& statements) {
+		for (Stmt*& stmt : statements) {
+			Stmt* kept = prune(stmt);
+			stmt = kept ? kept : emptyBlock();
+		}
+	}
+
+	// Nodes no longer in the tree
+	size_t removedNodes() const {
+		return removed;
+	}
+
+private:
+	// What is left of `stmt`, null when nothing is
+	Stmt* prune(Stmt* stmt) {
+		return stmt ? visit(stmt) : nullptr;
+	}
+
+	Stmt* visitBlock(BlockStmt* block) {
+		pruneList(block);
+		if (!block->stmts.empty()) return block;
+		removed += 1;
+		return nullptr;
+	}
+
+	Stmt* visitWhile(WhileStmt* whileStmt) {
+		if (isFalse(whileStmt->condition)) {
+			removed += NodeCounter::count(whileStmt);
+			return nullptr;
+		}
+		whileStmt->main = branch(whileStmt->main);
+		return whileStmt;
+	}
+
+	Stmt* visitFuncDecl(FuncDeclStmt* func) {
+		if (func->body) pruneList(func->body);
+		return func;
+	}
+
+	Stmt* visitClassDecl(ClassDeclStmt* cls) {
+		for (FuncDeclStmt* method : cls->methods) prune(method);
+		return cls;
+	}
+
+	Stmt* visitExpression(ExprStmt* stmt) {
+		return stmt;
+	}
+
+	Stmt* visitPrint(PrintStmt* stmt) {
+		return stmt;
+	}
+
+	Stmt* visitReturn(ReturnStmt* stmt) {
+		return stmt;
+	}
+
+	// Prunes the statements of `block` in place
+	void pruneList(BlockStmt* block) {
+		NodeList<Stmt*>& stmts = block->stmts;
+		size_t kept = 0;
+		size_t i = 0;
+		while (i < stmts.size()) {
+			Stmt* stmt = prune(stmts[i++]);
+			if (!stmt) continue;
+			stmts[kept++] = stmt;
+			// The block stops running once a return has run
+			if (alwaysReturns(stmt)) break;
+		}
+		for (; i < stmts.size(); i++) removed += NodeCounter::count(stmts[i]);
+		stmts.count = kept;
+	}
+
+	Stmt* visitIf(IfStmt* stmt) {
+		if (stmt->condition && stmt->condition->type == ExprType::Literal) {
+			bool taken = truthy(stmt->condition);
+			removed += 2 + NodeCounter::count(taken ? stmt->elseStmt : stmt->thenStmt);
+			return prune(taken ? stmt->thenStmt : stmt->elseStmt);
+		}
+
+		Stmt* thenStmt = prune(stmt->thenStmt);
+		stmt->elseStmt = prune(stmt->elseStmt);
+		if (thenStmt || stmt->elseStmt) {
+			stmt->thenStmt = thenStmt ? thenStmt : emptyBlock();
+			return stmt;
+		}
+		// Nothing left to run, but the condition may have effects
+		return program.arena.make<ExprStmt>(stmt->condition);
+	}
+
+	// A pruned loop body, which has to stay a statement
+	Stmt* branch(Stmt* stmt) {
+		Stmt* kept = prune(stmt);
+		return kept ? kept : emptyBlock();
+	}
+
+	// Whether running `stmt` always ends in a return
+	static bool alwaysReturns(Stmt* stmt) {
+		switch (stmt->type) {
+		case StmtType::RETURN:
+			return true;
+		case StmtType::BLOCK: {
+			NodeList<Stmt*>& stmts = ((BlockStmt*)stmt)->stmts;
+			return !stmts.empty() && alwaysReturns(stmts[stmts.size() - 1]);
+		}
+		case StmtType::IF: {
+			IfStmt* ifStmt = (IfStmt*)stmt;
+			return ifStmt->elseStmt && alwaysReturns(ifStmt->thenStmt) && alwaysReturns(ifStmt->elseStmt);
+		}
+		default:
+			return false;
+		}
+	}
+
+	static bool truthy(Expr* literal) {
+		return ((LiteralExpr*)literal)->value->value != 0;
+	}
+
+	static bool isFalse(Expr* condition) {
+		return condition && condition->type == ExprType::Literal && !truthy(condition);
+	}
+
+	// Stands in where a statement is required, counted against the removed nodes
+	BlockStmt* emptyBlock() {
+		removed -= 1;
+		return program.arena.make<BlockStmt>(NodeList<Stmt*>{});
+	}
+
+	Program& program;
+	size_t removed = 0;
+};
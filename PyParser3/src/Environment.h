@@ -7,75 +7,102 @@
 
 
 // Environment
+//
+// The root holds the globals in an array indexed by Symbol. A call frame
+// keeps the return value, self and the parameters in slots, numbered by
+// slotOf, and any other name it binds in a map. Names the Resolver bound
+// to a slot are read from it directly, the rest walk the parent chain.
 
 struct Environment {
 	Environment* parent;
 	bool isDead = false;
-	std::unordered_map<std::string, Object*> values;
+	std::unordered_map<Symbol, Object*> values;
+	// Root only, null where a name is unbound
+	std::vector<Object*> globals;
+	// Frames only, null where a name is unbound
+	std::vector<Object*> slots;
+	NodeList<const Token> params;
+
+	static constexpr size_t RetvalSlot = 0;
+	static constexpr size_t SelfSlot = 1;
+	static constexpr size_t None = ~(size_t)0;
 
 	Environment(Environment* _parent) : parent(_parent) {}
 
-	bool isLocalValue(std::string name) {
-		return values.count(name) != 0;
-	}
-	bool isValue(std::string name) {
-		if (isLocalValue(name)) {
-			return true;
-		}
-		if (parent == nullptr) return false;
-		return parent->isValue(name);
-	}
+	// A call frame for a function taking `_params`
+	Environment(Environment* _parent, NodeList<const Token> _params)
+		: parent(_parent), slots(2 + _params.size(), nullptr), params(_params) {}
 
-	Object* getValue(std::string name) {
-		if (!isValue(name)) {
-			ERR("Undefined variable {}", name);
-			return new NilObject{};
+	// The slot of `name` in frames of a function taking `params`, None when
+	// it has none. A repeated parameter takes the last argument.
+	static size_t slotOf(NodeList<const Token> params, Symbol name) {
+		if (name == Symbols::Retval) return RetvalSlot;
+		if (name == Symbols::Self) return SelfSlot;
+		for (size_t i = params.size(); i-- > 0;) {
+			if (params[i].symbol == name) return 2 + i;
 		}
-		if (isLocalValue(name))
-			return values[name];
-		return parent->getValue(name);
+		return None;
 	}
 
-	ObjRef getRef(std::string name) {
-		if (!isValue(name)) {
-			values[name] = new NilObject{};
-			return { &values[name] };
+	// The binding of `name` in this environment alone, null when there is none
+	Object** local(Symbol name) {
+		if (!parent) {
+			if (name < globals.size() && globals[name]) return &globals[name];
+			return nullptr;
+		}
+		if (!slots.empty()) {
+			size_t slot = slotOf(params, name);
+			if (slot != None) {
+				if (slots[slot]) return &slots[slot];
+				// An unbound self may still be bound further out
+				if (slot == SelfSlot) return nullptr;
+			}
 		}
-		if (isLocalValue(name))
-			return { &values[name] };
-		return parent->getRef(name);
+		auto it = values.find(name);
+		return it == values.end() ? nullptr : &it->second;
 	}
 
-	std::unordered_map<std::string, Object*>* getMap(std::string name) {
-		if (!isValue(name)) {
-			return &values;
+	// The binding of `name` here or in the nearest parent that has one
+	Object** find(Symbol name) {
+		for (Environment* env = this; env; env = env->parent) {
+			if (Object** binding = env->local(name)) return binding;
 		}
-		if (isLocalValue(name))
-			return &values;
-		return parent->getMap(name);
+		return nullptr;
 	}
 
-	//Object* setRef(std::string name) {
-	//	if (!isValue(name)) {
-	//		values[name] = nullptr;
-	//		return values[name];
-	//	}
-	//	if (isLocalValue(name))
-	//		return new RefObject{ &values[name] };
-	//	return parent->getRef(name);
-	//}
-
-	void setValue(std::string name, Object* value) {
-		if (isLocalValue(name) || !isValue(name)) {
-			values[name] = value;
+	// Binds `name` here, leaving it unset
+	Object** bind(Symbol name) {
+		if (!parent) {
+			if (name >= globals.size()) globals.resize(std::max<size_t>(name + 1, Symbols::count()), nullptr);
+			return &globals[name];
 		}
-		else {
-			parent->setValue(name, value);
+		if (!slots.empty()) {
+			size_t slot = slotOf(params, name);
+			if (slot != None) return &slots[slot];
 		}
+		return &values[name];
+	}
+
+	Object* getValue(Symbol name) {
+		if (Object** binding = find(name)) return *binding;
+		ERR("Undefined variable {}", Symbols::name(name));
+		return new NilObject{};
+	}
+
+	ObjRef getRef(Symbol name) {
+		if (Object** binding = find(name)) return { binding };
+		Object** binding = bind(name);
+		*binding = new NilObject{};
+		return { binding };
+	}
+
+	void setValue(Symbol name, Object* value) {
+		Object** binding = find(name);
+		*(binding ? binding : bind(name)) = value;
 	}
 
-	void setValueForce(std::string name, Object* value) {
-		values[name] = value;
+	void setValueForce(Symbol name, Object* value) {
+		*bind(name) = value;
 	}
 
 	Environment* getRootEnv() {
@@ -1,25 +1,14 @@
 #pragma once
 #include "pch.h"
 #include "Lexer.h"
-
-template<typename... Types>
-class Visitor;
-
-template<typename T, typename R>
-class Visitor<T,R> {
-public:
-	virtual R visit(T& visitable) = 0;
-};
-
-struct Expr2;
-
-template<typename R>
-using ExprVisitor = Visitor<Expr2, R>;
+#include "Arena.h"
 
 
 // Expressions
 
-enum class ExprType {
+struct FloatObject;
+
+enum class ExprType : uint8_t {
 	Literal,
 	Identifier,
 
@@ -41,14 +30,30 @@ struct Expr {
 
 struct LiteralExpr : public Expr {
 	Token token;
-	LiteralExpr(Token _token) {
+	// Decoded value, shared through the parser's ConstantPool
+	FloatObject* value;
+	LiteralExpr(Token _token, FloatObject* _value) {
 		type = ExprType::Literal;
 		token = _token;
+		value = _value;
 	}
 };
 
+// Where the Resolver found a name to live
+enum class Scope : uint8_t {
+	// Looked up through the environment chain
+	Dynamic,
+	// A slot of the current call frame
+	Frame,
+	// The root, indexed by Symbol
+	Global,
+};
+
 struct IdentifierExpr : public Expr {
 	Token token;
+	Scope scope = Scope::Dynamic;
+	// Frame slot, or the Symbol for a global
+	uint32_t slot = 0;
 	IdentifierExpr(Token _token) {
 		type = ExprType::Identifier;
 		token = _token;
@@ -91,8 +96,8 @@ struct AssignExpr : public Expr {
 
 struct FuncCallExpr : public Expr {
 	Expr* name;
-	std::vector<Expr*> args;
-	FuncCallExpr(Expr* _name, std::vector<Expr*> _args) {
+	NodeList<Expr*> args;
+	FuncCallExpr(Expr* _name, NodeList<Expr*> _args) {
 		type = ExprType::FuncCall;
 		name = _name;
 		args = _args;
@@ -0,0 +1,259 @@
+#pragma once
+#include "pch.h"
+#include "Token.h"
+#include "Arena.h"
+#include "Expression.h"
+#include "Statement.h"
+
+
+// Node indices into a FlatAst. Expressions and statements are numbered
+// separately, the distinct types keep the two from being mixed up.
+struct ExprId {
+	uint32_t index;
+	bool valid() const { return index != UINT32_MAX; }
+};
+
+struct StmtId {
+	uint32_t index;
+	bool valid() const { return index != UINT32_MAX; }
+};
+
+
+// The AST laid out as a struct of arrays. Each field of a node lives in its
+// own array indexed by the node id, children are 32 bit ids and operators a
+// single byte, so walking the tree reads a few dense arrays instead of
+// chasing pointers. Lists of children are runs in shared item arrays.
+//
+// Built once from a parsed tree and never modified. Literal values and
+// parameter tokens are borrowed from the Program it was built from, which
+// has to outlive it. Bodies skipped by a lazy parse must be parsed first,
+// see Parser::parseBodies.
+class FlatAst {
+public:
+	static constexpr uint32_t None = UINT32_MAX;
+
+	static FlatAst build(const std::vector<Stmt*>& statements) {
+		FlatAst ast;
+		size_t base = ast.stmtStack.size();
+		for (Stmt* stmt : statements) {
+			ast.stmtStack.push_back(ast.add(stmt));
+		}
+		ast.rootIds.assign(ast.stmtStack.begin() + base, ast.stmtStack.end());
+		ast.stmtStack = {};
+		ast.exprStack = {};
+		return ast;
+	}
+
+	NodeList<const StmtId> roots() const {
+		return { rootIds.data(), rootIds.size() };
+	}
+
+	size_t exprCount() const { return exprKinds.size(); }
+	size_t stmtCount() const { return stmtKinds.size(); }
+
+	// Expressions
+
+	ExprType type(ExprId expr) const { return exprKinds[expr.index]; }
+	// Unary and Binary
+	Token::Type oper(ExprId expr) const { return exprOpers[expr.index]; }
+	// Unary
+	ExprId operand(ExprId expr) const { return { exprA[expr.index] }; }
+	// Binary, Assign target and Get object
+	ExprId left(ExprId expr) const { return { exprA[expr.index] }; }
+	// Binary
+	ExprId right(ExprId expr) const { return { exprB[expr.index] }; }
+	// Assign
+	ExprId value(ExprId expr) const { return { exprB[expr.index] }; }
+	// FuncCall
+	ExprId callee(ExprId expr) const { return { exprA[expr.index] }; }
+	NodeList<const ExprId> args(ExprId expr) const { return items(exprItems, exprB[expr.index]); }
+	// Identifier name and Get attribute
+	Symbol symbol(ExprId expr) const { return exprB[expr.index]; }
+	// Literal
+	FloatObject* constant(ExprId expr) const { return literals[exprB[expr.index]].value; }
+	std::string_view literalText(ExprId expr) const { return literals[exprB[expr.index]].text; }
+
+	// Statements
+
+	StmtType type(StmtId stmt) const { return stmtKinds[stmt.index]; }
+	// Block
+	NodeList<const StmtId> stmts(StmtId stmt) const { return items(stmtItems, stmtA[stmt.index]); }
+	// Expression, Print and Return, invalid for a bare return
+	ExprId expr(StmtId stmt) const { return { stmtA[stmt.index] }; }
+	// If and While
+	ExprId condition(StmtId stmt) const { return { stmtA[stmt.index] }; }
+	StmtId thenStmt(StmtId stmt) const { return { stmtB[stmt.index] }; }
+	// Invalid without an else branch
+	StmtId elseStmt(StmtId stmt) const { return { stmtC[stmt.index] }; }
+	// While loop body and FuncDecl block
+	StmtId body(StmtId stmt) const { return { type(stmt) == StmtType::WHILE ? stmtB[stmt.index] : stmtC[stmt.index] }; }
+	// FuncDecl and ClassDecl
+	Symbol name(StmtId stmt) const { return stmtA[stmt.index]; }
+	NodeList<const Token> params(StmtId stmt) const { return items(paramItems, stmtB[stmt.index]); }
+	NodeList<const StmtId> methods(StmtId stmt) const { return items(stmtItems, stmtB[stmt.index]); }
+
+private:
+	struct Span {
+		uint32_t start;
+		uint32_t count;
+	};
+
+	struct Literal {
+		FloatObject* value;
+		std::string_view text;
+	};
+
+	template<typename T>
+	NodeList<const T> items(const std::vector<T>& from, uint32_t span) const {
+		return { from.data() + spans[span].start, spans[span].count };
+	}
+
+	// Building, children are always added before their parent
+
+	ExprId addExpr(ExprType kind, Token::Type oper, uint32_t a, uint32_t b) {
+		exprKinds.push_back(kind);
+		exprOpers.push_back(oper);
+		exprA.push_back(a);
+		exprB.push_back(b);
+		return { (uint32_t)exprKinds.size() - 1 };
+	}
+
+	StmtId addStmt(StmtType kind, uint32_t a, uint32_t b = None, uint32_t c = None) {
+		stmtKinds.push_back(kind);
+		stmtA.push_back(a);
+		stmtB.push_back(b);
+		stmtC.push_back(c);
+		return { (uint32_t)stmtKinds.size() - 1 };
+	}
+
+	// Moves the ids gathered on a stack since `base` into a span
+	template<typename T>
+	uint32_t finishSpan(std::vector<T>& stack, size_t base, std::vector<T>& to) {
+		spans.push_back({ (uint32_t)to.size(), (uint32_t)(stack.size() - base) });
+		to.insert(to.end(), stack.begin() + base, stack.end());
+		stack.resize(base);
+		return (uint32_t)spans.size() - 1;
+	}
+
+	ExprId add(Expr* expr) {
+		if (!expr) return { None };
+		switch (expr->type) {
+		case ExprType::Literal: {
+			LiteralExpr* literal = (LiteralExpr*)expr;
+			literals.push_back({ literal->value, literal->token.value });
+			return addExpr(ExprType::Literal, Token::Type::INTEGER, None, (uint32_t)literals.size() - 1);
+		}
+		case ExprType::Identifier:
+			return addExpr(ExprType::Identifier, Token::Type::IDENTIFIER, None, ((IdentifierExpr*)expr)->token.symbol);
+		case ExprType::Unary: {
+			UnaryExpr* unary = (UnaryExpr*)expr;
+			ExprId operand = add(unary->right);
+			return addExpr(ExprType::Unary, unary->oper.type, operand.index, None);
+		}
+		case ExprType::Binary: {
+			BinaryExpr* binary = (BinaryExpr*)expr;
+			ExprId left = add(binary->left);
+			ExprId right = add(binary->right);
+			return addExpr(ExprType::Binary, binary->oper.type, left.index, right.index);
+		}
+		case ExprType::Assign: {
+			AssignExpr* assign = (AssignExpr*)expr;
+			ExprId left = add(assign->left);
+			ExprId value = add(assign->value);
+			return addExpr(ExprType::Assign, Token::Type::EQUAL, left.index, value.index);
+		}
+		case ExprType::FuncCall: {
+			FuncCallExpr* call = (FuncCallExpr*)expr;
+			ExprId callee = add(call->name);
+			size_t base = exprStack.size();
+			for (Expr* arg : call->args) {
+				exprStack.push_back(add(arg));
+			}
+			uint32_t args = finishSpan(exprStack, base, exprItems);
+			return addExpr(ExprType::FuncCall, Token::Type::L_PAREN, callee.index, args);
+		}
+		case ExprType::Get: {
+			GetExpr* get = (GetExpr*)expr;
+			ExprId left = add(get->left);
+			return addExpr(ExprType::Get, Token::Type::DOT, left.index, get->right.symbol);
+		}
+		}
+		ERR("Unknown Expr Type");
+		return { None };
+	}
+
+	StmtId add(Stmt* stmt) {
+		if (!stmt) return { None };
+		switch (stmt->type) {
+		case StmtType::BLOCK: {
+			size_t base = stmtStack.size();
+			for (Stmt* inner : ((BlockStmt*)stmt)->stmts) {
+				stmtStack.push_back(add(inner));
+			}
+			return addStmt(StmtType::BLOCK, finishSpan(stmtStack, base, stmtItems));
+		}
+		case StmtType::EXPRESSION:
+			return addStmt(StmtType::EXPRESSION, add(((ExprStmt*)stmt)->expr).index);
+		case StmtType::PRINT:
+			return addStmt(StmtType::PRINT, add(((PrintStmt*)stmt)->expr).index);
+		case StmtType::IF: {
+			IfStmt* ifStmt = (IfStmt*)stmt;
+			ExprId condition = add(ifStmt->condition);
+			StmtId thenStmt = add(ifStmt->thenStmt);
+			StmtId elseStmt = add(ifStmt->elseStmt);
+			return addStmt(StmtType::IF, condition.index, thenStmt.index, elseStmt.index);
+		}
+		case StmtType::WHILE: {
+			WhileStmt* whileStmt = (WhileStmt*)stmt;
+			ExprId condition = add(whileStmt->condition);
+			StmtId body = add(whileStmt->main);
+			return addStmt(StmtType::WHILE, condition.index, body.index);
+		}
+		case StmtType::FUNC_DECL: {
+			FuncDeclStmt* func = (FuncDeclStmt*)stmt;
+			if (func->lazy) ERR("Function body was never parsed");
+			spans.push_back({ (uint32_t)paramItems.size(), (uint32_t)func->params.size() });
+			paramItems.insert(paramItems.end(), func->params.begin(), func->params.end());
+			uint32_t params = (uint32_t)spans.size() - 1;
+			StmtId body = add(func->body);
+			return addStmt(StmtType::FUNC_DECL, func->name.symbol, params, body.index);
+		}
+		case StmtType::RETURN:
+			return addStmt(StmtType::RETURN, add(((ReturnStmt*)stmt)->retVal).index);
+		case StmtType::CLASS_DECL: {
+			ClassDeclStmt* cls = (ClassDeclStmt*)stmt;
+			size_t base = stmtStack.size();
+			for (FuncDeclStmt* method : cls->methods) {
+				stmtStack.push_back(add(method));
+			}
+			return addStmt(StmtType::CLASS_DECL, cls->name.symbol, finishSpan(stmtStack, base, stmtItems));
+		}
+		}
+		ERR("Unknown Stmt Type");
+		return { None };
+	}
+
+	// Expressions
+	std::vector<ExprType> exprKinds;
+	std::vector<Token::Type> exprOpers;
+	std::vector<uint32_t> exprA;
+	std::vector<uint32_t> exprB;
+
+	// Statements
+	std::vector<StmtType> stmtKinds;
+	std::vector<uint32_t> stmtA;
+	std::vector<uint32_t> stmtB;
+	std::vector<uint32_t> stmtC;
+
+	// Lists and leaves
+	std::vector<Span> spans;
+	std::vector<ExprId> exprItems;
+	std::vector<StmtId> stmtItems;
+	std::vector<Token> paramItems;
+	std::vector<Literal> literals;
+	std::vector<StmtId> rootIds;
+
+	// Scratch space while building
+	std::vector<ExprId> exprStack;
+	std::vector<StmtId> stmtStack;
+};
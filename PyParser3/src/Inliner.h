@@ -0,0 +1,204 @@
+#pragma once
+#include "pch.h"
+#include "Expression.h"
+#include "Statement.h"
+#include "Program.h"
+#include "Visitor.h"
+
+
+// Replaces calls to small functions with the expression they return.
+//
+// Only functions that cannot behave differently inlined are candidates:
+// - declared once, at the top level, under a name nothing assigns, no
+//   class takes and no parameter shadows, so a call by that name always
+//   reaches them
+// - a body that starts with `return expr;`, with at most `maxNodes` nodes
+//   and no calls or assignments in it. Nothing after the return runs.
+//   Without calls nothing can be recursive, and nothing can see the
+//   parameters through the dynamic scope of the call. Names other than the
+//   parameters are looked up from the caller either way.
+//
+// Calls are only inlined after the declaration, in top level statements
+// that follow it, and when their arguments match the parameters. Each
+// argument takes the place of its parameter and is read where the
+// parameter is, so arguments have to be plain names or literals: anything
+// else would no longer run left to right before the body. The body cannot
+// assign, so a name still holds what it held at the call.
+//
+// Needs the whole program to see every assignment, so nothing is inlined
+// while a body is still waiting on a lazy parse.
+class Inliner : public TreeRewriter<Inliner> {
+	friend ExprVisitor<Inliner, Expr*>;
+	friend StmtVisitor<Inliner, Stmt*>;
+public:
+	Inliner(Program& _program, size_t _maxNodes)
+		: program(_program), maxNodes(_maxNodes) {}
+
+	void run(std::vector<Stmt*>& statements) {
+		scan.visit(statements);
+		if (scan.lazy) {
+			DEB("Not inlining, some bodies are not parsed yet");
+			return;
+		}
+		for (Stmt* stmt : statements) {
+			visit(stmt);
+			if (stmt->type == StmtType::FUNC_DECL) consider((FuncDeclStmt*)stmt);
+		}
+	}
+
+	size_t inlinedCalls() const {
+		return inlined;
+	}
+
+private:
+	struct Candidate {
+		FuncDeclStmt* func;
+		Expr* result;
+	};
+
+	// Whole program facts
+	struct Scan : public TreeWalker<Scan> {
+		std::unordered_map<Symbol, size_t> declared;
+		// Names assigned anywhere or used as a parameter
+		std::unordered_set<Symbol> shadowed;
+		bool lazy = false;
+
+		void visitFuncDecl(FuncDeclStmt* func) {
+			declared[func->name.symbol]++;
+			for (const Token& param : func->params) shadowed.insert(param.symbol);
+			if (func->lazy) lazy = true;
+			TreeWalker::visitFuncDecl(func);
+		}
+
+		void visitClassDecl(ClassDeclStmt* cls) {
+			declared[cls->name.symbol]++;
+			for (FuncDeclStmt* method : cls->methods) {
+				for (const Token& param : method->params) shadowed.insert(param.symbol);
+				if (method->lazy) lazy = true;
+				visit((Stmt*)method->body);
+			}
+		}
+
+		void visitAssign(AssignExpr* assign) {
+			if (assign->left && assign->left->type == ExprType::Identifier) {
+				shadowed.insert(((IdentifierExpr*)assign->left)->token.symbol);
+			}
+			TreeWalker::visitAssign(assign);
+		}
+	};
+
+	// Makes `func` a candidate for the statements after it, if it is one
+	void consider(FuncDeclStmt* func) {
+		Symbol name = func->name.symbol;
+		if (scan.declared[name] != 1 || scan.shadowed.count(name)) return;
+		BlockStmt* body = func->body;
+		if (body->stmts.empty() || !body->stmts[0] || body->stmts[0]->type != StmtType::RETURN) return;
+		Expr* result = ((ReturnStmt*)body->stmts[0])->retVal;
+		if (!result || NodeCounter::count(result) > maxNodes || !pure(result)) return;
+
+		for (size_t i = 0; i < func->params.size(); i++) {
+			for (size_t j = 0; j < i; j++) {
+				if (func->params[j].symbol == func->params[i].symbol) return;
+			}
+		}
+		candidates[name] = Candidate{ func, result };
+	}
+
+	// Rewriting
+
+	Expr* visitFuncCall(FuncCallExpr* call) {
+		TreeRewriter::visitFuncCall(call);
+		if (Expr* body = inlineCall(call)) {
+			inlined++;
+			return body;
+		}
+		return call;
+	}
+
+	// The candidate's result with the arguments of `call` in place of the
+	// parameters, null when the call cannot be inlined
+	Expr* inlineCall(FuncCallExpr* call) {
+		if (!call->name || call->name->type != ExprType::Identifier) return nullptr;
+		auto it = candidates.find(((IdentifierExpr*)call->name)->token.symbol);
+		if (it == candidates.end()) return nullptr;
+		const Candidate& candidate = it->second;
+		if (call->args.size() != candidate.func->params.size()) return nullptr;
+
+		for (Expr* arg : call->args) {
+			if (!arg || (arg->type != ExprType::Literal && arg->type != ExprType::Identifier)) return nullptr;
+			if (!pure(arg)) return nullptr;
+		}
+		return substitute(candidate.result, candidate.func->params, call->args);
+	}
+
+	// A copy of `expr`, parameters replaced by copies of their arguments
+	Expr* substitute(Expr* expr, NodeList<Token> params, NodeList<Expr*> args) {
+		if (!expr) return nullptr;
+		switch (expr->type) {
+		case ExprType::Literal:
+			return expr;
+		case ExprType::Identifier: {
+			Symbol name = ((IdentifierExpr*)expr)->token.symbol;
+			for (size_t i = 0; i < params.size(); i++) {
+				if (params[i].symbol == name) return copy(args[i]);
+			}
+			return make<IdentifierExpr>(((IdentifierExpr*)expr)->token);
+		}
+		case ExprType::Unary: {
+			UnaryExpr* unary = (UnaryExpr*)expr;
+			return make<UnaryExpr>(unary->oper, substitute(unary->right, params, args));
+		}
+		case ExprType::Binary: {
+			BinaryExpr* binary = (BinaryExpr*)expr;
+			Expr* left = substitute(binary->left, params, args);
+			Expr* right = substitute(binary->right, params, args);
+			return make<BinaryExpr>(left, binary->oper, right);
+		}
+		case ExprType::Get: {
+			GetExpr* get = (GetExpr*)expr;
+			return make<GetExpr>(substitute(get->left, params, args), get->right);
+		}
+		default:
+			// Candidates hold no calls or assignments
+			return expr;
+		}
+	}
+
+	// Arguments are copied since later passes rewrite nodes in place
+	Expr* copy(Expr* expr) {
+		return substitute(expr, {}, {});
+	}
+
+	// Helpers
+
+	static bool pure(Expr* expr) {
+		if (!expr) return true;
+		switch (expr->type) {
+		case ExprType::Identifier:
+			return ((IdentifierExpr*)expr)->token.symbol != Symbols::Retval;
+		case ExprType::Unary:
+			return pure(((UnaryExpr*)expr)->right);
+		case ExprType::Binary:
+			return pure(((BinaryExpr*)expr)->left) && pure(((BinaryExpr*)expr)->right);
+		case ExprType::Get:
+			return pure(((GetExpr*)expr)->left);
+		case ExprType::Assign:
+		case ExprType::FuncCall:
+			return false;
+		default:
+			return true;
+		}
+	}
+
+	template<typename T, typename... Args>
+	T* make(Args&&... args) {
+		return program.arena.make<T>(std::forward<Args>(args)...);
+	}
+
+	Program& program;
+	size_t maxNodes;
+	size_t inlined = 0;
+
+	Scan scan;
+	std::unordered_map<Symbol, Candidate> candidates;
+};
@@ -5,8 +5,14 @@
 #include "Statement.h"
 #include "Object.h"
 #include "Environment.h"
+#include "FlatAst.h"
+#include "Visitor.h"
 
-class Interpreter {
+class Jit;
+
+class Interpreter : public ExprVisitor<Interpreter, Object*>, public StmtVisitor<Interpreter> {
+	friend ExprVisitor<Interpreter, Object*>;
+	friend StmtVisitor<Interpreter>;
 public:
 	Interpreter() {
 		env = new Environment{ nullptr };
@@ -21,85 +27,59 @@ public:
 	}
 
 	void execute(Stmt* statement) {
-		switch (statement->type) {
-		case StmtType::FUNC_DECL:
-			DEB("Executing FuncDecl");
-			executeFuncDeclStmt((FuncDeclStmt*)statement);
-			break;
-		case StmtType::CLASS_DECL:
-			DEB("Executing ClassDecl");
-			executeClassDeclStmt((ClassDeclStmt*)statement);
-			break;
-		case StmtType::RETURN:
-			DEB("Executing Return");
-			executeReturnStmt((ReturnStmt*)statement);
-			break;
-
-		case StmtType::BLOCK:
-			DEB("Executing Block");
-			executeBlockStmt((BlockStmt*)statement);
-			break;
-		case StmtType::EXPRESSION:
-			DEB("Executing Expression");
-			executeExprStmt((ExprStmt*)statement);
-			break;
-		case StmtType::PRINT:
-			DEB("Executing Print");
-			executePrintStmt((PrintStmt*)statement);
-			break;
-		case StmtType::IF:
-			DEB("Executing IF");
-			executeIfStmt((IfStmt*)statement);
-			break;
-		case StmtType::WHILE:
-			DEB("Executing While");
-			executeWhileStmt((WhileStmt*)statement);
-			break;
-		}
+		StmtVisitor::visit(statement);
 	}
+
 private:
 
 	FuncObject* getFuncObject(FuncDeclStmt* stmt) {
-		return new FuncObject{ stmt->params, stmt->body };
+		return new FuncObject{ stmt };
 	}
 
-	void executeFuncDeclStmt(FuncDeclStmt* stmt) {
+	void visitFuncDecl(FuncDeclStmt* stmt) {
+		DEB("Executing FuncDecl");
 		FuncObject* funcObj = getFuncObject(stmt);
-		env->setValue(stmt->name.value, funcObj);
+		env->setValue(stmt->name.symbol, funcObj);
 	}
-	void executeClassDeclStmt(ClassDeclStmt* stmt) {
+	void visitClassDecl(ClassDeclStmt* stmt) {
+		DEB("Executing ClassDecl");
 		ClassObject* clsObj = new ClassObject{};
 		for (FuncDeclStmt* method : stmt->methods) {
 			FuncObject* funcObj = getFuncObject(method);
-			clsObj->addMethod(method->name.value, funcObj);
+			clsObj->addMethod(method->name.symbol, funcObj);
 		}
-		env->setValue(stmt->name.value, clsObj);
+		env->setValue(stmt->name.symbol, clsObj);
 	}
 
-	void executeReturnStmt(ReturnStmt* stmt) {
+	void visitReturn(ReturnStmt* stmt) {
+		DEB("Executing Return");
 		Object* retVal = stmt->retVal ? evaluate(stmt->retVal) : new NilObject{};
-		env->setValueForce("__retval__", retVal);
+		env->setValueForce(Symbols::Retval, retVal);
 		env->isDead = true;
 
 	}
 
-	void executeBlockStmt(BlockStmt* stmt) {
+	void visitBlock(BlockStmt* stmt) {
+		DEB("Executing Block");
 		for (Stmt* _stmt : stmt->stmts) {
 			if (env->isDead) break;
 			execute(_stmt);
 		}
 	}
 
-	void executeExprStmt(ExprStmt* stmt) {
+	void visitExpression(ExprStmt* stmt) {
+		DEB("Executing Expression");
 		evaluate(stmt->expr);
 	}
 
-	void executePrintStmt(PrintStmt* stmt) {
+	void visitPrint(PrintStmt* stmt) {
+		DEB("Executing Print");
 		Object* value = evaluate(stmt->expr);
 		std::cout << toFloat(value) << std::endl;
 	}
 
-	void executeIfStmt(IfStmt* stmt) {
+	void visitIf(IfStmt* stmt) {
+		DEB("Executing IF");
 		Object* value = evaluate(stmt->condition);
 		if (toFloat(value)) {
 			execute(stmt->thenStmt);
@@ -109,7 +89,8 @@ private:
 		}
 	}
 
-	void executeWhileStmt(WhileStmt* stmt) {
+	void visitWhile(WhileStmt* stmt) {
+		DEB("Executing While");
 		while (toFloat(evaluate(stmt->condition))) {
 			execute(stmt->main);
 		}
@@ -119,31 +100,12 @@ private:
 public:
 
 	Object* evaluate(Expr* expr) {
-		switch (expr->type)
-		{
-		case ExprType::Literal:
-			return evaluateLiteral((LiteralExpr*)expr);
-			//case ExprType::Unary:
-				//return evaluateUnary((UnaryExpr*)expr)
-		case ExprType::Binary:
-			return evaluateBinary((BinaryExpr*)expr);
-		case ExprType::Identifier:
-			return evaluateIdentifier((IdentifierExpr*)expr);
-		case ExprType::Assign:
-			return evaluateAssign((AssignExpr*)expr);
-		case ExprType::FuncCall:
-			return evaluateFuncCall((FuncCallExpr*)expr);
-		case ExprType::Get:
-			return evaluateGet((GetExpr*)expr);
-		default:
-			ERR("Unknown Expr Type:");
-			break;
-		}
+		return ExprVisitor::visit(expr);
 	}
 
 private:
-	Object* evaluateLiteral(LiteralExpr* expr) {
-		return new FloatObject{ (float)std::stoi(expr->token.value) };
+	Object* visitLiteral(LiteralExpr* expr) {
+		return expr->value;
 	}
 
 	float toFloat(Object* obj) {
@@ -155,13 +117,31 @@ private:
 		}
 	}
 
-	Object* evaluateBinary(BinaryExpr* expr) {
+	Object* visitBinary(BinaryExpr* expr) {
+		float left = toFloat(evaluate(expr->left));
+		float right = toFloat(evaluate(expr->right));
+		return binary(expr->oper.type, left, right);
+	}
 
+	Object* binary(Token::Type oper, float left, float right) {
+		return new FloatObject{ apply(oper, left, right) };
+	}
 
-		float left = toFloat(evaluate(expr->left));
+	Object* visitUnary(UnaryExpr* expr) {
 		float right = toFloat(evaluate(expr->right));
+		return new FloatObject{ unary(expr->oper.type, right) };
+	}
+
+public:
+	// Value of a unary operator on a number, shared with constant folding
+	static float unary(Token::Type oper, float right) {
+		return oper == Token::Type::MINUS ? -right : (right == 0 ? 1.0f : 0.0f);
+	}
+
+	// Value of a binary operator on two numbers, shared with constant folding
+	static float apply(Token::Type oper, float left, float right) {
 		float val = 0;
-		switch (expr->oper.type) {
+		switch (oper) {
 		case Token::Type::PLUS:
 			val = left + right; break;
 		case Token::Type::MINUS:
@@ -187,42 +167,60 @@ private:
 		default:
 			break;
 		}
-		return new FloatObject{ val };
-
+		return val;
 	}
 
-	Object* evaluateIdentifier(IdentifierExpr* expr) {
+private:
+
+	Object* visitIdentifier(IdentifierExpr* expr) {
 		DEB("Getting Value {}", expr->token.value);
-		return env->getValue(expr->token.value);
+		if (Object** binding = resolved(expr)) return *binding;
+		return env->getValue(expr->token.symbol);
 	}
 
-	Object* evaluateAssign(AssignExpr* expr) {
+	// The binding the Resolver placed `expr` in, null when it has to be looked up
+	Object** resolved(IdentifierExpr* expr) {
+		switch (expr->scope) {
+		case Scope::Frame: {
+			Object*& value = env->slots[expr->slot];
+			return value ? &value : nullptr;
+		}
+		case Scope::Global:
+			if (expr->slot >= env->globals.size() || !env->globals[expr->slot]) return nullptr;
+			return &env->globals[expr->slot];
+		default:
+			return nullptr;
+		}
+	}
+
+	Object* visitAssign(AssignExpr* expr) {
 		Object* value = evaluate(expr->value);
 		ObjRef left = evaluateRef(expr->left);
 		*(left.obj) = value;
 		return value;
 	}
 
-	Object* evaluateGet(GetExpr* expr) {
+	Object* visitGet(GetExpr* expr) {
 		Object* lObject = evaluate(expr->left);
-		return lObject->getAttr(expr->right.value);
+		return lObject->getAttr(expr->right.symbol);
 	}
 	ObjRef evaluateRef(Expr* expr) {
 		if (expr->type == ExprType::Identifier) {
 			IdentifierExpr* idExpr = (IdentifierExpr* )expr;
-			return env->getRef(idExpr->token.value);
+			if (Object** binding = resolved(idExpr)) return { binding };
+			return env->getRef(idExpr->token.symbol);
 		}
 		if (expr->type == ExprType::Get) {
 			GetExpr* getExpr = (GetExpr*)expr;
 			Object* lObject = evaluate(getExpr->left);
-			return lObject->getAttrRef(getExpr->right.value);
+			return lObject->getAttrRef(getExpr->right.symbol);
 		}
 		ERR("Illegal Reference");
 		return { nullptr };
 	}
 
 
-	Object* evaluateFuncCall(FuncCallExpr* expr) {
+	Object* visitFuncCall(FuncCallExpr* expr) {
 		// Includes object construction
 
 		std::vector<Object*> arguments; 
@@ -235,7 +233,121 @@ private:
 		return _func->call(arguments, this);
 	}
 
+	// Flat AST
+	// Same semantics as the pointer tree walk above, over a FlatAst
+public:
+
+	void execute(const FlatAst& ast) {
+		INFO("Starting Execution");
+
+		for (StmtId statement : ast.roots()) {
+			execute(ast, statement);
+		}
+	}
+
+	void execute(const FlatAst& ast, StmtId stmt) {
+		switch (ast.type(stmt)) {
+		case StmtType::FUNC_DECL:
+			env->setValue(ast.name(stmt), getFuncObject(ast, stmt));
+			break;
+		case StmtType::CLASS_DECL: {
+			ClassObject* clsObj = new ClassObject{};
+			for (StmtId method : ast.methods(stmt)) {
+				clsObj->addMethod(ast.name(method), getFuncObject(ast, method));
+			}
+			env->setValue(ast.name(stmt), clsObj);
+			break;
+		}
+		case StmtType::RETURN: {
+			ExprId retExpr = ast.expr(stmt);
+			Object* retVal = retExpr.valid() ? evaluate(ast, retExpr) : new NilObject{};
+			env->setValueForce(Symbols::Retval, retVal);
+			env->isDead = true;
+			break;
+		}
+		case StmtType::BLOCK:
+			for (StmtId inner : ast.stmts(stmt)) {
+				if (env->isDead) break;
+				execute(ast, inner);
+			}
+			break;
+		case StmtType::EXPRESSION:
+			evaluate(ast, ast.expr(stmt));
+			break;
+		case StmtType::PRINT:
+			std::cout << toFloat(evaluate(ast, ast.expr(stmt))) << std::endl;
+			break;
+		case StmtType::IF:
+			if (toFloat(evaluate(ast, ast.condition(stmt)))) {
+				execute(ast, ast.thenStmt(stmt));
+			}
+			else if (ast.elseStmt(stmt).valid()) {
+				execute(ast, ast.elseStmt(stmt));
+			}
+			break;
+		case StmtType::WHILE:
+			while (toFloat(evaluate(ast, ast.condition(stmt)))) {
+				execute(ast, ast.body(stmt));
+			}
+			break;
+		}
+	}
+
+	Object* evaluate(const FlatAst& ast, ExprId expr) {
+		switch (ast.type(expr)) {
+		case ExprType::Literal:
+			return ast.constant(expr);
+		case ExprType::Unary:
+			return new FloatObject{ unary(ast.oper(expr), toFloat(evaluate(ast, ast.operand(expr)))) };
+		case ExprType::Binary: {
+			float left = toFloat(evaluate(ast, ast.left(expr)));
+			float right = toFloat(evaluate(ast, ast.right(expr)));
+			return binary(ast.oper(expr), left, right);
+		}
+		case ExprType::Identifier:
+			return env->getValue(ast.symbol(expr));
+		case ExprType::Assign: {
+			Object* value = evaluate(ast, ast.value(expr));
+			ObjRef left = evaluateRef(ast, ast.left(expr));
+			*(left.obj) = value;
+			return value;
+		}
+		case ExprType::FuncCall: {
+			std::vector<Object*> arguments;
+			for (ExprId arg : ast.args(expr)) {
+				arguments.push_back(evaluate(ast, arg));
+			}
+			Object* _func = evaluate(ast, ast.callee(expr));
+			return _func->call(arguments, this);
+		}
+		case ExprType::Get:
+			return evaluate(ast, ast.left(expr))->getAttr(ast.symbol(expr));
+		default:
+			ERR("Unknown Expr Type:");
+			return new NilObject{};
+		}
+	}
+
+private:
+	FuncObject* getFuncObject(const FlatAst& ast, StmtId stmt) {
+		return new FuncObject{ ast.params(stmt), &ast, ast.body(stmt) };
+	}
+
+	ObjRef evaluateRef(const FlatAst& ast, ExprId expr) {
+		if (ast.type(expr) == ExprType::Identifier) {
+			return env->getRef(ast.symbol(expr));
+		}
+		if (ast.type(expr) == ExprType::Get) {
+			Object* lObject = evaluate(ast, ast.left(expr));
+			return lObject->getAttrRef(ast.symbol(expr));
+		}
+		ERR("Illegal Reference");
+		return { nullptr };
+	}
+
 public:
 	Environment* env;
+	// Runs hot functions natively when set
+	Jit* jit = nullptr;
 
 };
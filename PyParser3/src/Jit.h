@@ -0,0 +1,688 @@
+#pragma once
+#include "pch.h"
+#include "Expression.h"
+#include "Statement.h"
+#include "Object.h"
+#include "Environment.h"
+#include "Parser.h"
+#include "Resolver.h"
+#include "Interpreter.h"
+#include "Visitor.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+
+// What native code reaches through its first argument
+struct JitContext {
+	Interpreter* interpreter;
+	Environment* frame;
+	// The arguments as numbers, also the second argument
+	float* args;
+	size_t count;
+	// Set when the function returned nil rather than a number
+	uint8_t nil;
+};
+
+// A function body compiled to executable memory
+struct JitCode {
+	using Entry = float (*)(JitContext*, float*);
+	Entry entry = nullptr;
+	size_t size = 0;
+
+	JitCode() = default;
+	JitCode(const JitCode&) = delete;
+	~JitCode() {
+#if JIT_SUPPORTED
+		if (entry) munmap((void*)entry, size);
+#endif
+	}
+};
+
+
+// Encodes the few x86-64 instructions the JIT emits. Numbers are computed
+// in xmm0, with xmm1 for the other operand. rbx holds the JitContext, r12
+// the arguments, and temporaries live in 4 byte slots from rsp.
+class X64Assembler {
+public:
+	std::vector<uint8_t> code;
+
+	size_t here() const {
+		return code.size();
+	}
+
+	// push rbp; mov rbp, rsp; push rbx; push r12; sub rsp, frame
+	// mov rbx, rdi; mov r12, rsi
+	// Returns where the frame size goes
+	size_t prologue() {
+		bytes({ 0x55, 0x48, 0x89, 0xE5, 0x53, 0x41, 0x54, 0x48, 0x81, 0xEC });
+		size_t frame = here();
+		imm32(0);
+		bytes({ 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4 });
+		return frame;
+	}
+
+	// add rsp, frame; pop r12; pop rbx; pop rbp; ret
+	size_t epilogue() {
+		bytes({ 0x48, 0x81, 0xC4 });
+		size_t frame = here();
+		imm32(0);
+		bytes({ 0x41, 0x5C, 0x5B, 0x5D, 0xC3 });
+		return frame;
+	}
+
+	// movss xmm, [r12 + 4 * index]
+	void loadArg(int xmm, uint32_t index) {
+		bytes({ 0xF3, 0x41, 0x0F, 0x10, (uint8_t)(0x84 | xmm << 3), 0x24 });
+		imm32(4 * index);
+	}
+
+	// movss [r12 + 4 * index], xmm0
+	void storeArg(uint32_t index) {
+		bytes({ 0xF3, 0x41, 0x0F, 0x11, 0x84, 0x24 });
+		imm32(4 * index);
+	}
+
+	// movss xmm, [rsp + 4 * slot]
+	void loadTemp(int xmm, size_t slot) {
+		bytes({ 0xF3, 0x0F, 0x10, (uint8_t)(0x84 | xmm << 3), 0x24 });
+		imm32((uint32_t)(4 * slot));
+	}
+
+	// movss [rsp + 4 * slot], xmm0
+	void storeTemp(size_t slot) {
+		bytes({ 0xF3, 0x0F, 0x11, 0x84, 0x24 });
+		imm32((uint32_t)(4 * slot));
+	}
+
+	// mov eax, bits; movd xmm, eax
+	void loadConst(int xmm, float value) {
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		bytes({ 0xB8 });
+		imm32(bits);
+		bytes({ 0x66, 0x0F, 0x6E, (uint8_t)(0xC0 | xmm << 3) });
+	}
+
+	// movaps xmm1, xmm0
+	void copyToSecond() {
+		bytes({ 0x0F, 0x28, 0xC8 });
+	}
+
+	// movaps xmm0, xmm1
+	void copyToFirst() {
+		bytes({ 0x0F, 0x28, 0xC1 });
+	}
+
+	// addss, subss, mulss or divss xmm0, xmm1
+	void arithmetic(uint8_t op) {
+		bytes({ 0xF3, 0x0F, op, 0xC1 });
+	}
+	static constexpr uint8_t Add = 0x58;
+	static constexpr uint8_t Mul = 0x59;
+	static constexpr uint8_t Sub = 0x5C;
+	static constexpr uint8_t Div = 0x5E;
+
+	// cmpss xmm0, xmm1 or, swapped, xmm1, xmm0, then the all ones mask
+	// of a true comparison turned into 1.0 in xmm0
+	void compare(uint8_t predicate, bool swapped) {
+		bytes({ 0xF3, 0x0F, 0xC2, (uint8_t)(swapped ? 0xC8 : 0xC1), predicate });
+		if (swapped) copyToFirst();
+		loadConst(1, 1.0f);
+		// andps xmm0, xmm1
+		bytes({ 0x0F, 0x54, 0xC1 });
+	}
+	static constexpr uint8_t Equal = 0;
+	static constexpr uint8_t Less = 1;
+	static constexpr uint8_t LessEqual = 2;
+	static constexpr uint8_t NotEqual = 4;
+
+	// xorps xmm0, the sign bit
+	void negate() {
+		loadConst(1, -0.0f);
+		bytes({ 0x0F, 0x57, 0xC1 });
+	}
+
+	// xmm0 = xmm0 == 0 ? 1 : 0
+	void logicalNot() {
+		copyToSecond();
+		// xorps xmm0, xmm0
+		bytes({ 0x0F, 0x57, 0xC0 });
+		compare(Equal, false);
+	}
+
+	// Jumps when xmm0 is 0, which NaN is not. Returns where the target goes.
+	size_t jumpIfZero() {
+		// xorps xmm1, xmm1; cmpneqss xmm0, xmm1; movd eax, xmm0; test eax, eax; jz
+		bytes({ 0x0F, 0x57, 0xC9, 0xF3, 0x0F, 0xC2, 0xC1, NotEqual, 0x66, 0x0F, 0x7E, 0xC0, 0x85, 0xC0, 0x0F, 0x84 });
+		size_t target = here();
+		imm32(0);
+		return target;
+	}
+
+	size_t jump() {
+		bytes({ 0xE9 });
+		size_t target = here();
+		imm32(0);
+		return target;
+	}
+
+	void jumpTo(size_t target) {
+		bytes({ 0xE9 });
+		imm32((uint32_t)(target - (here() + 4)));
+	}
+
+	// Points the jump whose target is at `at` to the next instruction
+	void bind(size_t at) {
+		patch32(at, (uint32_t)(here() - (at + 4)));
+	}
+
+	// The helper is called with the JitContext, `first`, the temporaries
+	// from `slot` on and `count`, as
+	// mov rdi, rbx; mov esi, first; lea rdx, [rsp + 4 * slot]; mov ecx, count;
+	// mov rax, helper; call rax
+	void callHelper(const void* helper, uint32_t first, size_t slot, uint32_t count) {
+		bytes({ 0x48, 0x89, 0xDF, 0xBE });
+		imm32(first);
+		bytes({ 0x48, 0x8D, 0x94, 0x24 });
+		imm32((uint32_t)(4 * slot));
+		bytes({ 0xB9 });
+		imm32(count);
+		call(helper);
+	}
+
+	// mov rax, helper; call rax, with xmm0 as it is
+	void call(const void* helper) {
+		bytes({ 0x48, 0xB8 });
+		uint64_t address = (uint64_t)(uintptr_t)helper;
+		for (int i = 0; i < 8; i++) code.push_back((uint8_t)(address >> (8 * i)));
+		bytes({ 0xFF, 0xD0 });
+	}
+
+	// mov byte [rbx + offset], 1
+	void setFlag(size_t offset) {
+		bytes({ 0xC6, 0x83 });
+		imm32((uint32_t)offset);
+		code.push_back(1);
+	}
+
+	void patch32(size_t at, uint32_t value) {
+		std::memcpy(&code[at], &value, sizeof(value));
+	}
+
+private:
+	void bytes(std::initializer_list<uint8_t> list) {
+		code.insert(code.end(), list);
+	}
+
+	void imm32(uint32_t value) {
+		size_t at = code.size();
+		code.resize(at + sizeof(value));
+		std::memcpy(&code[at], &value, sizeof(value));
+	}
+};
+
+
+// Compiles function bodies that only compute with numbers: literals, the
+// parameters, arithmetic, comparisons, if, while, print and calls to named
+// functions. Anything else is left to the Interpreter, with the reason
+// kept for the stats. What a call returns is only used as a number, so
+// calls are not compiled where their result would be kept as an object:
+// returned, assigned or passed to another call.
+//
+// Code reads the parameters as numbers, so callers check each argument is
+// one. A callee may still see and assign the caller's parameters through
+// dynamic scoping, so the call helper reloads them, and functions that
+// both assign parameters and make calls are left out. Return only marks
+// the frame dead in the Interpreter and loops keep testing their
+// condition, so functions returning from inside a loop are left out too.
+class JitCompiler : public ExprVisitor<JitCompiler, bool>, public StmtVisitor<JitCompiler, bool> {
+	friend ExprVisitor<JitCompiler, bool>;
+	friend StmtVisitor<JitCompiler, bool>;
+public:
+	static constexpr size_t MaxParams = 16;
+
+	// Code for the body of `func`, or false with the reason it has none
+	static bool compile(FuncDeclStmt* func, const void* callHelper, const void* printHelper, std::vector<uint8_t>& code, std::string& reason) {
+		JitCompiler compiler{ callHelper, printHelper };
+		if (!compiler.run(func)) {
+			reason = compiler.reason;
+			return false;
+		}
+		code = std::move(compiler.as.code);
+		return true;
+	}
+
+private:
+	JitCompiler(const void* _callHelper, const void* _printHelper)
+		: callHelper(_callHelper), printHelper(_printHelper) {}
+
+	bool run(FuncDeclStmt* func) {
+		if (func->params.size() > MaxParams) return reject("takes more than 16 parameters");
+		Scan scan;
+		scan.visit((Stmt*)func->body);
+		if (scan.calls && scan.assignsParam) return reject("assigns a parameter and makes calls");
+
+		size_t frameIn = as.prologue();
+		if (!statement(func->body)) return false;
+		// Falling off the end returns the nil the frame started with
+		as.setFlag(offsetof(JitContext, nil));
+		for (size_t exit : returns) as.bind(exit);
+		size_t frameOut = as.epilogue();
+
+		// Keeps rsp 16 byte aligned at calls, after the three pushes
+		uint32_t frame = (uint32_t)((4 * maxDepth + 15) & ~(size_t)15);
+		as.patch32(frameIn, frame);
+		as.patch32(frameOut, frame);
+		return true;
+	}
+
+	bool reject(std::string why) {
+		if (reason.empty()) reason = std::move(why);
+		return false;
+	}
+
+	bool statement(Stmt* stmt) {
+		if (!stmt) return reject("has a statement that failed to parse");
+		return StmtVisitor::visit(stmt);
+	}
+
+	// Leaves the value in xmm0
+	bool expression(Expr* expr) {
+		if (!expr) return reject("has an expression that failed to parse");
+		return ExprVisitor::visit(expr);
+	}
+
+	// Statements
+
+	bool visitBlock(BlockStmt* stmt) {
+		for (Stmt* inner : stmt->stmts) {
+			if (!statement(inner)) return false;
+		}
+		return true;
+	}
+
+	bool visitExpression(ExprStmt* stmt) {
+		return expression(stmt->expr);
+	}
+
+	bool visitPrint(PrintStmt* stmt) {
+		if (!expression(stmt->expr)) return false;
+		as.call(printHelper);
+		return true;
+	}
+
+	bool visitIf(IfStmt* stmt) {
+		if (!expression(stmt->condition)) return false;
+		size_t toElse = as.jumpIfZero();
+		if (!statement(stmt->thenStmt)) return false;
+		if (!stmt->elseStmt) {
+			as.bind(toElse);
+			return true;
+		}
+		size_t toEnd = as.jump();
+		as.bind(toElse);
+		if (!statement(stmt->elseStmt)) return false;
+		as.bind(toEnd);
+		return true;
+	}
+
+	bool visitWhile(WhileStmt* stmt) {
+		size_t top = as.here();
+		if (!expression(stmt->condition)) return false;
+		size_t toEnd = as.jumpIfZero();
+		loops++;
+		if (!statement(stmt->main)) return false;
+		loops--;
+		as.jumpTo(top);
+		as.bind(toEnd);
+		return true;
+	}
+
+	bool visitFuncDecl(FuncDeclStmt*) {
+		return reject("declares a function");
+	}
+
+	bool visitClassDecl(ClassDeclStmt*) {
+		return reject("declares a class");
+	}
+
+	bool visitReturn(ReturnStmt* stmt) {
+		if (loops) return reject("returns from inside a loop");
+		if (!stmt->retVal) {
+			as.setFlag(offsetof(JitContext, nil));
+		}
+		else {
+			if (stmt->retVal->type == ExprType::FuncCall) return reject("returns what a call returned");
+			if (!expression(stmt->retVal)) return false;
+		}
+		returns.push_back(as.jump());
+		return true;
+	}
+
+	// Expressions
+
+	bool visitLiteral(LiteralExpr* expr) {
+		as.loadConst(0, expr->value->value);
+		return true;
+	}
+
+	bool visitIdentifier(IdentifierExpr* expr) {
+		if (!isParam(expr)) return reject("reads " + std::string(Symbols::name(expr->token.symbol)) + ", which is not a parameter");
+		as.loadArg(0, expr->slot - 2);
+		return true;
+	}
+
+	bool visitUnary(UnaryExpr* expr) {
+		if (!expression(expr->right)) return false;
+		if (expr->oper.type == Token::Type::MINUS) as.negate();
+		else as.logicalNot();
+		return true;
+	}
+
+	bool visitBinary(BinaryExpr* expr) {
+		Token::Type oper = expr->oper.type;
+		if (!isOperator(oper)) return reject("uses an operator with no value");
+		if (!expression(expr->left)) return false;
+		// A right operand needing no code of its own is loaded straight
+		// into xmm1, anything else is computed with the left one saved
+		if (expr->right && expr->right->type == ExprType::Literal) {
+			as.loadConst(1, ((LiteralExpr*)expr->right)->value->value);
+		}
+		else if (expr->right && expr->right->type == ExprType::Identifier && isParam((IdentifierExpr*)expr->right)) {
+			as.loadArg(1, ((IdentifierExpr*)expr->right)->slot - 2);
+		}
+		else {
+			size_t slot = push();
+			as.storeTemp(slot);
+			if (!expression(expr->right)) return false;
+			pop();
+			as.copyToSecond();
+			as.loadTemp(0, slot);
+		}
+		switch (oper) {
+		case Token::Type::PLUS: as.arithmetic(X64Assembler::Add); break;
+		case Token::Type::MINUS: as.arithmetic(X64Assembler::Sub); break;
+		case Token::Type::STAR: as.arithmetic(X64Assembler::Mul); break;
+		case Token::Type::DIV: as.arithmetic(X64Assembler::Div); break;
+		case Token::Type::EQUAL_EQUAL: as.compare(X64Assembler::Equal, false); break;
+		case Token::Type::BANG_EQUAL: as.compare(X64Assembler::NotEqual, false); break;
+		case Token::Type::LESS: as.compare(X64Assembler::Less, false); break;
+		case Token::Type::LESS_EQUAL: as.compare(X64Assembler::LessEqual, false); break;
+		case Token::Type::GREAT: as.compare(X64Assembler::Less, true); break;
+		case Token::Type::GREAT_EQUAL: as.compare(X64Assembler::LessEqual, true); break;
+		default: break;
+		}
+		return true;
+	}
+
+	bool visitAssign(AssignExpr* expr) {
+		Expr* target = expr->left;
+		if (!target || target->type != ExprType::Identifier || !isParam((IdentifierExpr*)target)) {
+			return reject("assigns to something other than a parameter");
+		}
+		if (expr->value && expr->value->type == ExprType::FuncCall) return reject("assigns what a call returned");
+		if (!expression(expr->value)) return false;
+		as.storeArg(((IdentifierExpr*)target)->slot - 2);
+		return true;
+	}
+
+	bool visitFuncCall(FuncCallExpr* expr) {
+		Expr* callee = expr->name;
+		if (!callee || callee->type != ExprType::Identifier || isParam((IdentifierExpr*)callee)) {
+			return reject("calls something other than a named function");
+		}
+		// The arguments go in consecutive temporaries
+		size_t base = depth;
+		for (Expr* arg : expr->args) {
+			if (arg && arg->type == ExprType::FuncCall) return reject("passes what a call returned");
+			if (!expression(arg)) return false;
+			as.storeTemp(push());
+		}
+		depth = base;
+		as.callHelper(callHelper, ((IdentifierExpr*)callee)->token.symbol, base, (uint32_t)expr->args.size());
+		return true;
+	}
+
+	bool visitGet(GetExpr*) {
+		return reject("reads an attribute");
+	}
+
+	// Helpers
+
+	struct Scan : public TreeWalker<Scan> {
+		bool calls = false;
+		bool assignsParam = false;
+
+		void visitFuncCall(FuncCallExpr* expr) {
+			calls = true;
+			TreeWalker::visitFuncCall(expr);
+		}
+
+		void visitAssign(AssignExpr* expr) {
+			if (expr->left && expr->left->type == ExprType::Identifier && isParam((IdentifierExpr*)expr->left)) {
+				assignsParam = true;
+			}
+			TreeWalker::visitAssign(expr);
+		}
+	};
+
+	static bool isParam(IdentifierExpr* expr) {
+		return expr->scope == Scope::Frame && expr->slot >= 2;
+	}
+
+	static bool isOperator(Token::Type oper) {
+		switch (oper) {
+		case Token::Type::PLUS:
+		case Token::Type::MINUS:
+		case Token::Type::STAR:
+		case Token::Type::DIV:
+		case Token::Type::EQUAL_EQUAL:
+		case Token::Type::BANG_EQUAL:
+		case Token::Type::LESS:
+		case Token::Type::LESS_EQUAL:
+		case Token::Type::GREAT:
+		case Token::Type::GREAT_EQUAL:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	size_t push() {
+		size_t slot = depth++;
+		maxDepth = std::max(maxDepth, depth);
+		return slot;
+	}
+
+	void pop() {
+		depth--;
+	}
+
+	X64Assembler as;
+	const void* callHelper;
+	const void* printHelper;
+	// Jumps to the epilogue
+	std::vector<size_t> returns;
+	size_t loops = 0;
+	size_t depth = 0;
+	size_t maxDepth = 0;
+	std::string reason;
+};
+
+
+// Baseline JIT for the Interpreter, on x86-64 Linux. FuncObject::call asks
+// it first; it counts the calls of each function and, once a function is
+// hot, runs its body as native code if JitCompiler could compile it. Calls
+// with arguments that are not all numbers go to the Interpreter.
+class Jit {
+public:
+	struct Options {
+		// Calls to a function before its body is compiled
+		uint32_t threshold = 100;
+	};
+
+	struct Stats {
+		size_t compiledFunctions = 0;
+		size_t rejectedFunctions = 0;
+		size_t codeBytes = 0;
+		size_t nativeCalls = 0;
+		// Calls to compiled functions the Interpreter ran instead
+		size_t fallbacks = 0;
+	};
+
+	Jit() = default;
+
+	Jit(Options _options)
+		: options(_options) {}
+
+	// Runs `func` natively into `result`, false when the Interpreter has to
+	bool call(FuncObject* func, const std::vector<Object*>& arguments, Interpreter* interpreter, Object*& result) {
+		if (!func->decl) return false;
+		if (!func->native) {
+			if (func->calls++ != options.threshold) return false;
+			func->native = compiled(func->decl);
+			if (!func->native) return false;
+		}
+
+		size_t count = func->params.size();
+		if (arguments.size() != count) {
+			stats.fallbacks++;
+			return false;
+		}
+		float values[JitCompiler::MaxParams];
+		for (size_t i = 0; i < count; i++) {
+			if (arguments[i]->getType() != Object::Type::FLOAT) {
+				stats.fallbacks++;
+				return false;
+			}
+			values[i] = ((FloatObject*)arguments[i])->value;
+		}
+
+		Environment* frame = new Environment{ interpreter->env, func->params };
+		for (size_t i = 0; i < count; i++) {
+			frame->slots[2 + i] = arguments[i];
+		}
+		frame->slots[Environment::SelfSlot] = func->binding;
+		frame->slots[Environment::RetvalSlot] = new NilObject{};
+
+		interpreter->env = frame;
+		JitContext context{ interpreter, frame, values, count, 0 };
+		float value = func->native->entry(&context, values);
+		interpreter->env = frame->parent;
+
+		stats.nativeCalls++;
+		result = context.nil ? frame->slots[Environment::RetvalSlot] : new FloatObject{ value };
+		return true;
+	}
+
+	const Stats& getStats() const {
+		return stats;
+	}
+
+	void dumpStats() const {
+		for (const Record& record : records) {
+			if (record.bytes) INFO("JIT compiled {} into {} bytes", record.name, record.bytes);
+			else INFO("JIT left {} to the interpreter, it {}", record.name, record.reason);
+		}
+		INFO("JIT compiled {} functions into {} bytes and rejected {}, ran {} calls natively and {} fell back",
+			stats.compiledFunctions, stats.codeBytes, stats.rejectedFunctions, stats.nativeCalls, stats.fallbacks);
+	}
+
+private:
+	struct Record {
+		std::string name;
+		size_t bytes;
+		std::string reason;
+	};
+
+	// The code for `decl`, compiled once however many times it is declared,
+	// null when it cannot be
+	const JitCode* compiled(FuncDeclStmt* decl) {
+		auto it = codes.find(decl);
+		if (it != codes.end()) return it->second.get();
+
+		// Bodies parsed lazily are parsed by the first call, unless the
+		// threshold is 0
+		if (decl->lazy) {
+			Parser::body(decl);
+			Resolver::resolve(decl);
+		}
+		std::string name{ Symbols::name(decl->name.symbol) };
+		std::vector<uint8_t> code;
+		std::string reason;
+		std::unique_ptr<JitCode> native;
+		if (!JIT_SUPPORTED) {
+			reason = "needs x86-64 Linux";
+		}
+		else if (JitCompiler::compile(decl, (const void*)&callHelper, (const void*)&printHelper, code, reason)) {
+			native = install(code);
+			if (!native) reason = "could not be mapped executable";
+		}
+
+		if (native) {
+			stats.compiledFunctions++;
+			stats.codeBytes += code.size();
+			records.push_back({ name, code.size(), "" });
+			DEB("JIT compiled {} into {} bytes", name, code.size());
+		}
+		else {
+			stats.rejectedFunctions++;
+			records.push_back({ name, 0, reason });
+			DEB("JIT left {} to the interpreter, it {}", name, reason);
+		}
+		return (codes[decl] = std::move(native)).get();
+	}
+
+	// Copies `code` to memory mapped for it, executable once written
+	static std::unique_ptr<JitCode> install(const std::vector<uint8_t>& code) {
+#if JIT_SUPPORTED
+		void* memory = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED) return nullptr;
+		std::memcpy(memory, code.data(), code.size());
+		if (mprotect(memory, code.size(), PROT_READ | PROT_EXEC) != 0) {
+			munmap(memory, code.size());
+			return nullptr;
+		}
+		std::unique_ptr<JitCode> native = std::make_unique<JitCode>();
+		native->entry = (JitCode::Entry)memory;
+		native->size = code.size();
+		return native;
+#else
+		return nullptr;
+#endif
+	}
+
+	// Called by native code with the arguments computed, then looks up the
+	// callee, as the Interpreter does
+	static float callHelper(JitContext* context, uint32_t callee, const float* args, uint32_t count) {
+		Interpreter* interpreter = context->interpreter;
+		std::vector<Object*> arguments;
+		for (uint32_t i = 0; i < count; i++) arguments.push_back(new FloatObject{ args[i] });
+		Object* func = interpreter->env->getValue(callee);
+		Object* result = func->call(arguments, interpreter);
+		for (size_t i = 0; i < context->count; i++) {
+			context->args[i] = number(context->frame->slots[2 + i]);
+		}
+		return number(result);
+	}
+
+	static void printHelper(float value) {
+		std::cout << value << std::endl;
+	}
+
+	static float number(Object* value) {
+		if (value && value->getType() == Object::Type::FLOAT) {
+			return ((FloatObject*)value)->value;
+		}
+		return 0;
+	}
+
+	Options options;
+	Stats stats;
+	std::unordered_map<FuncDeclStmt*, std::unique_ptr<JitCode>> codes;
+	std::vector<Record> records;
+};
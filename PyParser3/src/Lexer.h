@@ -1,66 +1,59 @@
 #pragma once
 #include "pch.h"
+#include "MappedFile.h"
+#include "CharScan.h"
+#include "Token.h"
+#include "LexerTables.h"
+#include "ThreadPool.h"
 
 
 
-struct Token {
-	enum class Type {
-		INTEGER,
-		IDENTIFIER,
-
-		PLUS,
-		MINUS,
-		STAR,
-		DIV,
-
-		BANG,
-		BANG_EQUAL,
-		EQUAL_EQUAL,
-		LESS,
-		LESS_EQUAL,
-		GREAT,
-		GREAT_EQUAL,
-
-		EQUAL,
-
-		L_PAREN,
-		R_PAREN,
-		L_BRACE,
-		R_BRACE,
-
-		//Keywords
-		VAR,
-		PRINT,
-		IF,
-		ELSE,
-		WHILE,
-		FUN,
-		RETURN,
-		CLASS,
-		SELF,
-
-		SEMICOLON,
-		COMMA,
-		DOT,
-
-		END
+// One edit of a source buffer: `removed` bytes at `offset` were replaced
+// by `inserted` new bytes.
+struct SourceEdit {
+	size_t offset;
+	size_t removed;
+	size_t inserted;
+};
 
-	};
-	Token::Type type;
-	std::string value;
+// Tokens of an edited source. Tokens [first, first + relexed) are new and
+// take the place of [first, first + replaced) in the previous buffer; all
+// the others were carried over from it.
+struct RelexResult {
+	std::vector<Token> tokens;
+	size_t first = 0;
+	size_t relexed = 0;
+	size_t replaced = 0;
+	// The replaced tokens, still pointing into the previous source
+	std::vector<Token> removed;
 };
+
 class Lexer {
 public:
-	Lexer(std::string path) {
-		set_kw_map();
+	enum class Mode {
+		// Lex the whole source up front, tokens are read with getTokens()
+		Batch,
+		// Lex on demand, tokens are pulled one at a time with nextToken()
+		Stream,
+		// Like Batch, but large sources are split into chunks lexed on the
+		// shared ThreadPool
+		Parallel,
+	};
 
+	Lexer(std::string path, Mode mode = Mode::Batch) {
 		INFO("Reading file : {}", path);
-		source = readFile(path);
+		file.open(path);
+		source = file.view();
 		
 		INFO("Starting Lexing");
-		parseSource();
+		lex(mode);
 
 	}
+
+	// Lexes source that is already in memory, which must outlive the tokens
+	static Lexer fromSource(std::string_view source, Mode mode = Mode::Batch) {
+		return Lexer{ SourceTag{}, source, mode };
+	}
 	
 	bool isEnd(int offset) {
 		return idx + offset >= source.length();
@@ -84,169 +77,249 @@ public:
 		return source[idx++];
 	}
 	
-	bool isDigit(char chr) {
-		return chr >= '0' && chr <= '9';
+	// Moves past a run of characters of one class, many bytes at a time
+	void skip(const char* (*scan)(const char*, const char*)) {
+		const char* begin = source.data();
+		idx = (size_t)(scan(begin + idx, begin + source.length()) - begin);
 	}
 
-	bool isAlpha(char chr) {
-		return chr >= 'A' && chr <= 'Z' || chr >= 'a' && chr <= 'z' || chr == '_';
-	}
 
-	bool isWhitespace(char chr) {
-		return chr == ' ' || chr == '\t' || chr == '\r' || chr == '\n';
+	void lex(Mode mode) {
+		if (mode == Mode::Batch) {
+			parseSource();
+		}
+		else if (mode == Mode::Parallel) {
+			parseSourceParallel();
+		}
 	}
 
-
 	void parseSource() {
 		while (!isEnd()) {
-			char chr = peek();
-			switch (chr)
-			{
-			case '+':
-				AddToken(Token::Type::PLUS);
-				advance();
-				break;
-			case '-':
-				AddToken(Token::Type::MINUS);
-				advance();
-				break;
-			case '*':
-				AddToken(Token::Type::STAR);
-				advance();
-				break;
-			case '/':
-				AddToken(Token::Type::DIV);
-				advance();
-				break;
-			case '=':
-				advance();
-				if (peek() == '=') {
-					AddToken(Token::Type::EQUAL_EQUAL);
-					advance();
-					break;
-				}
-				AddToken(Token::Type::EQUAL);
-				break;
-			case '!':
-				advance();
-				if (peek() == '=') {
-					AddToken(Token::Type::BANG_EQUAL);
-					advance();
-					break;
-				}
-				AddToken(Token::Type::BANG);
-				break;
-			case '<':
-				advance();
-				if (peek() == '=') {
-					AddToken(Token::Type::LESS_EQUAL);
-					advance();
-					break;
-				}
-				AddToken(Token::Type::LESS);
-				break;
-			case '>':
-				advance();
-				if (peek() == '=') {
-					AddToken(Token::Type::GREAT_EQUAL);
-					advance();
-					break;
-				}
-				AddToken(Token::Type::GREAT);
-				break;
+			scanToken();
+		}
+		AddToken(Token::Type::END);
+	}
 
-			case '(':
-				AddToken(Token::Type::L_PAREN);
-				advance();
-				break;
-			case ')':
-				AddToken(Token::Type::R_PAREN);
-				advance();
-				break;
-			case '{':
-				AddToken(Token::Type::L_BRACE);
-				advance();
-				break;
-			case '}':
-				AddToken(Token::Type::R_BRACE);
-				advance();
-				break;
-			case ';':
-				AddToken(Token::Type::SEMICOLON);
-				advance();
-				break;
-			case ',':
-				AddToken(Token::Type::COMMA);
-				advance();
-				break;
-			case '.':
-				AddToken(Token::Type::DOT);
-				advance();
-				break;
+	// Splits the source at whitespace, lexes the chunks on the thread pool and
+	// joins their tokens in order. Gives the same tokens as parseSource().
+	void parseSourceParallel() {
+		ThreadPool& pool = ThreadPool::shared();
+		size_t chunkCount = std::min(pool.size(), source.length() / MinChunkSize);
+		if (chunkCount < 2) {
+			parseSource();
+			return;
+		}
 
-			default:
-				if (isDigit(chr)) {
-					AddNumber();
-				}
-				else if (isAlpha(chr)) {
-					AddIdentifier();
+		std::vector<std::future<std::pair<std::vector<Token>, size_t>>> chunks;
+		size_t begin = 0;
+		for (size_t i = 1; i <= chunkCount; i++) {
+			size_t end = i == chunkCount ? source.length() : chunkBoundary(source.length() * i / chunkCount);
+			if (end <= begin) continue;
+
+			std::string_view chunk = source.substr(begin, end - begin);
+			chunks.push_back(pool.submit([chunk] {
+				Lexer part{ SourceTag{}, chunk, Mode::Stream };
+				while (!part.isEnd()) {
+					part.scanToken();
 				}
-				else if (isWhitespace(chr)) {
-					advance();
-				}
-				break;
-			}
+				return std::make_pair(std::move(part.tokens), part.errors);
+			}));
+			begin = end;
+		}
+
+		std::vector<std::vector<Token>> lexed;
+		size_t total = 0;
+		for (auto& chunk : chunks) {
+			auto [part, partErrors] = chunk.get();
+			lexed.push_back(std::move(part));
+			total += lexed.back().size();
+			errors += partErrors;
 		}
+		tokens.reserve(total + 1);
+		for (const std::vector<Token>& part : lexed) {
+			tokens.insert(tokens.end(), part.begin(), part.end());
+		}
+		idx = source.length();
 		AddToken(Token::Type::END);
+		DEB("Lexed {} chunks on {} threads", lexed.size(), pool.size());
 	}
 
-	void AddToken(Token::Type type) {
-		tokens.push_back({ type, "" });
+	// First whitespace at or after offset. No token contains whitespace, so
+	// lexing can be split there without changing the result.
+	size_t chunkBoundary(size_t offset) {
+		const char* begin = source.data();
+		const char* end = begin + source.length();
+		const char* p = begin + offset;
+		while (p < end && LexerTables::classes[(uint8_t)*p] != LexerTables::CharClass::Whitespace) p++;
+		return p - begin;
 	}
-	void AddToken(Token::Type type, std::string value) {
-		tokens.push_back({ type, value });
+
+	// Returns the next token, lexing only as much source as it needs.
+	// Keeps returning END once the source is exhausted.
+	Token nextToken() {
+		// In stream mode the buffer only ever holds the token being handed out
+		while (tokens.empty() && !isEnd()) {
+			scanToken();
+		}
+		if (tokens.empty()) return { Token::Type::END, source.substr(idx, 0) };
+		Token token = tokens.back();
+		tokens.clear();
+		return token;
 	}
 
-	void AddNumber() {
-		int start = idx;
-		while (isDigit(peek())) advance();
-		int end = idx;
-		AddToken(Token::Type::INTEGER, source.substr(start, end - start));
+	// Consumes one lexeme, adding at most one token.
+	// Steps the DFA from LexerTables until the next byte has no transition.
+	void scanToken() {
+		using LexerTables::State;
+		using LexerTables::Action;
+
+		size_t start = idx;
+		State state = State::Start;
+		while (!isEnd()) {
+			State next = LexerTables::next(state, peek());
+			if (next == State::Dead) break;
+			state = next;
+			advance();
+
+			// These states only loop on themselves, so take the whole run at once
+			if (state == State::Whitespace) skip(CharScan::skipWhitespace);
+			else if (state == State::Identifier) skip(CharScan::skipIdentifier);
+			else if (state == State::Number) skip(CharScan::skipDigits);
+		}
+
+		const LexerTables::Accept& accept = LexerTables::accept(state);
+		switch (accept.action) {
+		case Action::Emit:
+			AddToken(accept.type, source.substr(start, idx - start));
+			break;
+		case Action::Identifier:
+			AddIdentifier(source.substr(start, idx - start));
+			break;
+		case Action::Skip:
+			break;
+		case Action::Error:
+			ERR("Unexpected character '{}'", peek());
+			errors++;
+			advance();
+			break;
+		}
 	}
 
-	void AddIdentifier() {
-		int start = idx;
-		while (isAlpha(peek()) || isDigit(peek())) advance();
-		int end = idx;
-		std::string token_name = source.substr(start, end - start);
+	// Empty token at the current position
+	void AddToken(Token::Type type) {
+		tokens.push_back({ type, source.substr(idx, 0) });
+	}
+	void AddToken(Token::Type type, std::string_view value) {
+		tokens.push_back({ type, value });
+	}
 
-		if (kw_map.count(token_name) > 0) {
-			AddToken(kw_map[token_name]);
+	void AddIdentifier(std::string_view token_name) {
+		Token::Type keyword = LexerTables::keyword(token_name);
+		if (keyword != Token::Type::IDENTIFIER) {
+			AddToken(keyword, token_name);
 		}
 		else {
-			AddToken(Token::Type::IDENTIFIER, token_name);
+			tokens.push_back({ Token::Type::IDENTIFIER, token_name, Symbols::intern(token_name) });
 		}
 	}
 
-	std::vector<Token> getTokens() { return tokens; }
+	// Lexes `source`, which is `oldSource` after `edit`, reusing every token
+	// of `oldTokens` the edit can't have changed. Lexing restarts at the
+	// token touching the edit and stops as soon as a new token lines up with
+	// a shifted old one past the edit, since the rest of the text is the
+	// same and lexing carries no state from one token to the next.
+	static RelexResult relex(std::string_view oldSource, const std::vector<Token>& oldTokens,
+		std::string_view source, SourceEdit edit) {
+		return relex(oldSource, std::vector<Token>(oldTokens), source, edit);
+	}
+
+	// Same, but updates the old buffer in place instead of building a new
+	// one, which for large buffers costs more than the relexing itself
+	static RelexResult relex(std::string_view oldSource, std::vector<Token>&& oldTokens,
+		std::string_view source, SourceEdit edit) {
+		RelexResult result;
+		std::vector<Token>& tokens = result.tokens;
+		tokens = std::move(oldTokens);
+
+		auto oldOffset = [&oldSource](const Token& token) {
+			return (size_t)(token.value.data() - oldSource.data());
+		};
+
+		ptrdiff_t delta = (ptrdiff_t)edit.inserted - (ptrdiff_t)edit.removed;
+		size_t editEnd = edit.offset + edit.inserted;
+
+		// A token ending right at the edit could grow into it, so it's lexed again
+		size_t first = 0;
+		while (first + 1 < tokens.size() &&
+			oldOffset(tokens[first]) + tokens[first].value.size() < edit.offset) {
+			first++;
+		}
 
-	void set_kw_map() {
-		kw_map["var"] = Token::Type::VAR;
-		kw_map["print"] = Token::Type::PRINT;
-		kw_map["if"] = Token::Type::IF;
-		kw_map["else"] = Token::Type::ELSE;
-		kw_map["while"] = Token::Type::WHILE;
-		kw_map["fun"] = Token::Type::FUN;
-		kw_map["return"] = Token::Type::RETURN;
-		kw_map["class"] = Token::Type::CLASS;
-		//kw_map["self"] = Token::Type::SELF;
+		std::vector<Token> fresh;
+		size_t restart = std::min(edit.offset, oldOffset(tokens[first]));
+		Lexer lexer{ SourceTag{}, source.substr(restart), Mode::Stream };
+		size_t old = first;
+		while (true) {
+			Token token = lexer.nextToken();
+			size_t offset = token.value.data() - source.data();
+			if (offset >= editEnd) {
+				size_t shifted = (size_t)((ptrdiff_t)offset - delta);
+				while (old < tokens.size() && oldOffset(tokens[old]) < shifted) old++;
+				if (old < tokens.size() && oldOffset(tokens[old]) == shifted) break;
+			}
+			fresh.push_back(token);
+			if (token.type == Token::Type::END) {
+				old = tokens.size();
+				break;
+			}
+		}
+
+		// Carried over tokens keep their text, `shift` bytes further along in
+		// the new source
+		auto move = [&](size_t begin, size_t end, ptrdiff_t shift) {
+			for (size_t i = begin; i < end; i++) {
+				tokens[i].value = { source.data() + oldOffset(tokens[i]) + shift, tokens[i].value.size() };
+			}
+		};
+		move(0, first, 0);
+		move(old, tokens.size(), delta);
+
+		result.first = first;
+		result.relexed = fresh.size();
+		result.replaced = old - first;
+		result.removed.assign(tokens.begin() + first, tokens.begin() + old);
+		tokens.erase(tokens.begin() + first, tokens.begin() + old);
+		tokens.insert(tokens.begin() + first, fresh.begin(), fresh.end());
+
+		DEB("Relexed {} tokens in place of {}, reused {}", result.relexed, result.replaced,
+			tokens.size() - result.relexed);
+		return result;
 	}
 
+	const std::vector<Token>& getTokens() { return tokens; }
+
+	// Hands the token buffer over without copying it.
+	// Token values point into this lexer's source, so it must outlive them.
+	std::vector<Token> takeTokens() { return std::move(tokens); }
+
+	// Unexpected characters reported so far
+	size_t errors = 0;
+
 private:
-	std::unordered_map<std::string, Token::Type> kw_map;
+	struct SourceTag {};
+
+	Lexer(SourceTag, std::string_view _source, Mode mode)
+		: source(_source) {
+		lex(mode);
+	}
+
+	// Smallest piece of source worth handing to another thread
+	static constexpr size_t MinChunkSize = 1 << 20;
+
 	std::vector<Token> tokens;
-	std::string source;
-	int idx = 0;
+	MappedFile file;
+	std::string_view source;
+	size_t idx = 0;
 };
 
 
@@ -0,0 +1,269 @@
+#pragma once
+#include "pch.h"
+#include "Token.h"
+
+
+// Tables driving the Lexer, all built at compile time.
+//
+// Bytes are grouped into CharClasses to write the transitions down, which
+// are then expanded per byte. The lexer steps the DFA one lookup per byte
+// until there is no transition, and the state it stopped in tells what was
+// read. Identifiers are then checked against a perfect hash of the
+// keywords.
+namespace LexerTables {
+
+	enum class CharClass : uint8_t {
+		Other,
+		Whitespace,
+		Alpha,
+		Digit,
+		Plus,
+		Minus,
+		Star,
+		Slash,
+		Equal,
+		Bang,
+		Less,
+		Greater,
+		LParen,
+		RParen,
+		LBrace,
+		RBrace,
+		Semicolon,
+		Comma,
+		Dot,
+	};
+
+	enum class State : uint8_t {
+		// No transition, the lexeme ends before this byte
+		Dead,
+		Start,
+
+		Whitespace,
+		Identifier,
+		Number,
+
+		Plus,
+		Minus,
+		Star,
+		Slash,
+		LParen,
+		RParen,
+		LBrace,
+		RBrace,
+		Semicolon,
+		Comma,
+		Dot,
+
+		Equal,
+		EqualEqual,
+		Bang,
+		BangEqual,
+		Less,
+		LessEqual,
+		Greater,
+		GreaterEqual,
+
+		Count
+	};
+
+	// What a lexeme ending in a given state turns into
+	enum class Action : uint8_t {
+		// Nothing was consumed, the byte isn't part of the language
+		Error,
+		Skip,
+		Emit,
+		Identifier,
+	};
+
+	struct Accept {
+		Action action;
+		Token::Type type;
+	};
+
+	constexpr size_t StateCount = (size_t)State::Count;
+
+	constexpr std::array<CharClass, 256> buildClasses() {
+		std::array<CharClass, 256> classes{};
+		for (int chr = 'a'; chr <= 'z'; chr++) classes[chr] = CharClass::Alpha;
+		for (int chr = 'A'; chr <= 'Z'; chr++) classes[chr] = CharClass::Alpha;
+		for (int chr = '0'; chr <= '9'; chr++) classes[chr] = CharClass::Digit;
+		classes['_'] = CharClass::Alpha;
+		classes[' '] = CharClass::Whitespace;
+		classes['\t'] = CharClass::Whitespace;
+		classes['\r'] = CharClass::Whitespace;
+		classes['\n'] = CharClass::Whitespace;
+		classes['+'] = CharClass::Plus;
+		classes['-'] = CharClass::Minus;
+		classes['*'] = CharClass::Star;
+		classes['/'] = CharClass::Slash;
+		classes['='] = CharClass::Equal;
+		classes['!'] = CharClass::Bang;
+		classes['<'] = CharClass::Less;
+		classes['>'] = CharClass::Greater;
+		classes['('] = CharClass::LParen;
+		classes[')'] = CharClass::RParen;
+		classes['{'] = CharClass::LBrace;
+		classes['}'] = CharClass::RBrace;
+		classes[';'] = CharClass::Semicolon;
+		classes[','] = CharClass::Comma;
+		classes['.'] = CharClass::Dot;
+		return classes;
+	}
+
+	constexpr std::array<CharClass, 256> classes = buildClasses();
+
+	// Indexed by state then by byte, so stepping costs a single lookup
+	using TransitionTable = std::array<std::array<State, 256>, StateCount>;
+
+	constexpr TransitionTable buildTransitions() {
+		TransitionTable next{};
+		auto set = [&next](State from, CharClass on, State to) {
+			for (size_t chr = 0; chr < 256; chr++) {
+				if (classes[chr] == on) next[(size_t)from][chr] = to;
+			}
+		};
+
+		set(State::Start, CharClass::Whitespace, State::Whitespace);
+		set(State::Start, CharClass::Alpha, State::Identifier);
+		set(State::Start, CharClass::Digit, State::Number);
+		set(State::Start, CharClass::Plus, State::Plus);
+		set(State::Start, CharClass::Minus, State::Minus);
+		set(State::Start, CharClass::Star, State::Star);
+		set(State::Start, CharClass::Slash, State::Slash);
+		set(State::Start, CharClass::LParen, State::LParen);
+		set(State::Start, CharClass::RParen, State::RParen);
+		set(State::Start, CharClass::LBrace, State::LBrace);
+		set(State::Start, CharClass::RBrace, State::RBrace);
+		set(State::Start, CharClass::Semicolon, State::Semicolon);
+		set(State::Start, CharClass::Comma, State::Comma);
+		set(State::Start, CharClass::Dot, State::Dot);
+		set(State::Start, CharClass::Equal, State::Equal);
+		set(State::Start, CharClass::Bang, State::Bang);
+		set(State::Start, CharClass::Less, State::Less);
+		set(State::Start, CharClass::Greater, State::Greater);
+
+		set(State::Whitespace, CharClass::Whitespace, State::Whitespace);
+		set(State::Identifier, CharClass::Alpha, State::Identifier);
+		set(State::Identifier, CharClass::Digit, State::Identifier);
+		set(State::Number, CharClass::Digit, State::Number);
+
+		set(State::Equal, CharClass::Equal, State::EqualEqual);
+		set(State::Bang, CharClass::Equal, State::BangEqual);
+		set(State::Less, CharClass::Equal, State::LessEqual);
+		set(State::Greater, CharClass::Equal, State::GreaterEqual);
+		return next;
+	}
+
+	constexpr std::array<Accept, StateCount> buildAccepts() {
+		std::array<Accept, StateCount> accepts{};
+		auto emit = [&accepts](State state, Token::Type type) {
+			accepts[(size_t)state] = { Action::Emit, type };
+		};
+
+		accepts[(size_t)State::Whitespace] = { Action::Skip, Token::Type::END };
+		accepts[(size_t)State::Identifier] = { Action::Identifier, Token::Type::IDENTIFIER };
+		accepts[(size_t)State::Number] = { Action::Emit, Token::Type::INTEGER };
+
+		emit(State::Plus, Token::Type::PLUS);
+		emit(State::Minus, Token::Type::MINUS);
+		emit(State::Star, Token::Type::STAR);
+		emit(State::Slash, Token::Type::DIV);
+		emit(State::LParen, Token::Type::L_PAREN);
+		emit(State::RParen, Token::Type::R_PAREN);
+		emit(State::LBrace, Token::Type::L_BRACE);
+		emit(State::RBrace, Token::Type::R_BRACE);
+		emit(State::Semicolon, Token::Type::SEMICOLON);
+		emit(State::Comma, Token::Type::COMMA);
+		emit(State::Dot, Token::Type::DOT);
+		emit(State::Equal, Token::Type::EQUAL);
+		emit(State::EqualEqual, Token::Type::EQUAL_EQUAL);
+		emit(State::Bang, Token::Type::BANG);
+		emit(State::BangEqual, Token::Type::BANG_EQUAL);
+		emit(State::Less, Token::Type::LESS);
+		emit(State::LessEqual, Token::Type::LESS_EQUAL);
+		emit(State::Greater, Token::Type::GREAT);
+		emit(State::GreaterEqual, Token::Type::GREAT_EQUAL);
+		return accepts;
+	}
+
+	constexpr TransitionTable transitions = buildTransitions();
+	constexpr std::array<Accept, StateCount> accepts = buildAccepts();
+
+	constexpr State next(State state, char chr) {
+		return transitions[(size_t)state][(uint8_t)chr];
+	}
+
+	constexpr const Accept& accept(State state) {
+		return accepts[(size_t)state];
+	}
+
+
+	// Keywords
+
+	struct Keyword {
+		std::string_view text;
+		Token::Type type;
+	};
+
+	constexpr std::array<Keyword, 8> keywords = { {
+		{ "var", Token::Type::VAR },
+		{ "print", Token::Type::PRINT },
+		{ "if", Token::Type::IF },
+		{ "else", Token::Type::ELSE },
+		{ "while", Token::Type::WHILE },
+		{ "fun", Token::Type::FUN },
+		{ "return", Token::Type::RETURN },
+		{ "class", Token::Type::CLASS },
+		//{ "self", Token::Type::SELF },
+	} };
+
+	constexpr size_t KeywordSlots = 16;
+
+	constexpr size_t keywordHash(std::string_view text, unsigned seed) {
+		return ((uint8_t)text.front() * seed + (uint8_t)text.back()) & (KeywordSlots - 1);
+	}
+
+	constexpr bool isPerfect(unsigned seed) {
+		std::array<bool, KeywordSlots> used{};
+		for (const Keyword& keyword : keywords) {
+			size_t slot = keywordHash(keyword.text, seed);
+			if (used[slot]) return false;
+			used[slot] = true;
+		}
+		return true;
+	}
+
+	// Smallest multiplier that sends every keyword to its own slot
+	constexpr unsigned findSeed() {
+		for (unsigned seed = 1; seed < 256; seed++) {
+			if (isPerfect(seed)) return seed;
+		}
+		return 0;
+	}
+
+	constexpr unsigned keywordSeed = findSeed();
+	static_assert(keywordSeed != 0, "No perfect hash for the keyword set, grow KeywordSlots");
+
+	constexpr std::array<Keyword, KeywordSlots> buildKeywordSlots() {
+		std::array<Keyword, KeywordSlots> slots{};
+		for (size_t i = 0; i < KeywordSlots; i++) {
+			slots[i] = { "", Token::Type::IDENTIFIER };
+		}
+		for (const Keyword& keyword : keywords) {
+			slots[keywordHash(keyword.text, keywordSeed)] = keyword;
+		}
+		return slots;
+	}
+
+	constexpr std::array<Keyword, KeywordSlots> keywordSlots = buildKeywordSlots();
+
+	// IDENTIFIER unless the text is a keyword; one probe, one compare
+	constexpr Token::Type keyword(std::string_view text) {
+		const Keyword& slot = keywordSlots[keywordHash(text, keywordSeed)];
+		return slot.text == text ? slot.type : Token::Type::IDENTIFIER;
+	}
+
+	static_assert(keyword("while") == Token::Type::WHILE);
+	static_assert(keyword("whale") == Token::Type::IDENTIFIER);
+}
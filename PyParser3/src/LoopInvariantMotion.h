@@ -0,0 +1,230 @@
+#pragma once
+#include "pch.h"
+#include "Expression.h"
+#include "Statement.h"
+#include "Program.h"
+#include "Visitor.h"
+
+
+// Moves expressions a while loop computes the same way on every iteration
+// out of it, into temporaries assigned once before the loop.
+//
+// An expression is invariant when it has no calls or assignments, and no
+// name or attribute it reads is assigned anywhere in the loop, on any
+// object. Loops with a call in them are left alone, since through dynamic
+// scoping a call can assign any name the loop reads.
+//
+// Only expressions every iteration evaluates are moved: those in the
+// condition and in the expression and print statements the body starts
+// with. The loop is then guarded by its own condition,
+//     if (cond) { $licm0 = ...; while (cond) ... }
+// so nothing is evaluated that the loop would not have evaluated. That
+// needs a condition without effects, so loops assigning in their
+// condition are left alone too.
+//
+// Temporaries are named `$licmN`, which no script can spell. Inner loops
+// are done first, and their temporaries count as assigned in the outer
+// loop. Bodies still waiting on a lazy parse are left alone.
+class LoopInvariantMotion : public TreeRewriter<LoopInvariantMotion> {
+	friend ExprVisitor<LoopInvariantMotion, Expr*>;
+	friend StmtVisitor<LoopInvariantMotion, Stmt*>;
+public:
+	LoopInvariantMotion(Program& _program)
+		: program(_program) {}
+
+	void run(std::vector<Stmt*>& statements) {
+		visit(statements);
+	}
+
+	size_t hoistedExpressions() const {
+		return hoisted;
+	}
+
+private:
+	// What running a loop can change
+	struct Writes : public TreeWalker<Writes> {
+		std::unordered_set<Symbol> names;
+		std::unordered_set<Symbol> attributes;
+		bool calls = false;
+
+		void visitAssign(AssignExpr* assign) {
+			if (assign->left && assign->left->type == ExprType::Identifier) {
+				names.insert(((IdentifierExpr*)assign->left)->token.symbol);
+			}
+			else if (assign->left && assign->left->type == ExprType::Get) {
+				attributes.insert(((GetExpr*)assign->left)->right.symbol);
+			}
+			TreeWalker::visitAssign(assign);
+		}
+
+		void visitFuncCall(FuncCallExpr*) {
+			calls = true;
+		}
+
+		// Sets the return value, then skips the rest of the body
+		void visitReturn(ReturnStmt* stmt) {
+			names.insert(Symbols::Retval);
+			TreeWalker::visitReturn(stmt);
+		}
+
+		// Declaring only binds the name, bodies run when called
+		void visitFuncDecl(FuncDeclStmt* stmt) {
+			names.insert(stmt->name.symbol);
+		}
+
+		void visitClassDecl(ClassDeclStmt* stmt) {
+			names.insert(stmt->name.symbol);
+		}
+	};
+
+	// Inner loops first, then this one
+	Stmt* visitWhile(WhileStmt* loop) {
+		TreeRewriter::visitWhile(loop);
+		return hoist(loop);
+	}
+
+	Stmt* hoist(WhileStmt* loop) {
+		if (!pure(loop->condition)) return loop;
+		Writes writes;
+		writes.visit(loop->condition);
+		writes.visit(loop->main);
+		if (writes.calls) return loop;
+
+		Expr* guard = copy(loop->condition);
+		std::vector<Stmt*> assigns;
+		hoist(loop->condition, writes, assigns);
+		if (loop->main && loop->main->type == StmtType::BLOCK) {
+			for (Stmt* stmt : ((BlockStmt*)loop->main)->stmts) {
+				if (!hoist(stmt, writes, assigns)) break;
+			}
+		}
+		else if (loop->main) {
+			hoist(loop->main, writes, assigns);
+		}
+		if (assigns.empty()) return loop;
+
+		assigns.push_back(loop);
+		BlockStmt* block = make<BlockStmt>(program.arena.list(assigns.data(), assigns.size()));
+		return make<IfStmt>(guard, block, nullptr);
+	}
+
+	// Hoists out of an expression or print statement, false for any other
+	bool hoist(Stmt* stmt, const Writes& writes, std::vector<Stmt*>& assigns) {
+		switch (stmt->type) {
+		case StmtType::EXPRESSION:
+			hoist(((ExprStmt*)stmt)->expr, writes, assigns);
+			return true;
+		case StmtType::PRINT:
+			hoist(((PrintStmt*)stmt)->expr, writes, assigns);
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// Replaces the largest invariant parts of `expr` with temporaries
+	void hoist(Expr*& expr, const Writes& writes, std::vector<Stmt*>& assigns) {
+		if (!expr) return;
+		if (invariant(expr, writes)) {
+			// Names and literals cost as much to read as a temporary
+			if (expr->type == ExprType::Literal || expr->type == ExprType::Identifier) return;
+			Token name = temporary();
+			assigns.push_back(make<ExprStmt>(make<AssignExpr>(make<IdentifierExpr>(name), expr)));
+			expr = make<IdentifierExpr>(name);
+			hoisted++;
+			return;
+		}
+		switch (expr->type) {
+		case ExprType::Unary:
+			hoist(((UnaryExpr*)expr)->right, writes, assigns);
+			break;
+		case ExprType::Binary:
+			hoist(((BinaryExpr*)expr)->left, writes, assigns);
+			hoist(((BinaryExpr*)expr)->right, writes, assigns);
+			break;
+		case ExprType::Assign:
+			hoist(((AssignExpr*)expr)->value, writes, assigns);
+			break;
+		case ExprType::Get:
+			hoist(((GetExpr*)expr)->left, writes, assigns);
+			break;
+		default:
+			break;
+		}
+	}
+
+	Token temporary() {
+		std::string name = "$licm" + std::to_string(temporaries++);
+		Symbol symbol = Symbols::intern(name);
+		// The symbol table keeps the text for the life of the process
+		return Token{ Token::Type::IDENTIFIER, Symbols::name(symbol), symbol };
+	}
+
+	// Helpers
+
+	static bool invariant(Expr* expr, const Writes& writes) {
+		if (!expr) return false;
+		switch (expr->type) {
+		case ExprType::Literal:
+			return true;
+		case ExprType::Identifier:
+			return !writes.names.count(((IdentifierExpr*)expr)->token.symbol);
+		case ExprType::Unary:
+			return invariant(((UnaryExpr*)expr)->right, writes);
+		case ExprType::Binary:
+			return invariant(((BinaryExpr*)expr)->left, writes) && invariant(((BinaryExpr*)expr)->right, writes);
+		case ExprType::Get:
+			return !writes.attributes.count(((GetExpr*)expr)->right.symbol) && invariant(((GetExpr*)expr)->left, writes);
+		default:
+			return false;
+		}
+	}
+
+	static bool pure(Expr* expr) {
+		if (!expr) return true;
+		switch (expr->type) {
+		case ExprType::Unary:
+			return pure(((UnaryExpr*)expr)->right);
+		case ExprType::Binary:
+			return pure(((BinaryExpr*)expr)->left) && pure(((BinaryExpr*)expr)->right);
+		case ExprType::Get:
+			return pure(((GetExpr*)expr)->left);
+		case ExprType::Assign:
+		case ExprType::FuncCall:
+			return false;
+		default:
+			return true;
+		}
+	}
+
+	// A copy of a pure expression, since hoisting rewrites the original in place
+	Expr* copy(Expr* expr) {
+		if (!expr) return nullptr;
+		switch (expr->type) {
+		case ExprType::Unary: {
+			UnaryExpr* unary = (UnaryExpr*)expr;
+			return make<UnaryExpr>(unary->oper, copy(unary->right));
+		}
+		case ExprType::Binary: {
+			BinaryExpr* binary = (BinaryExpr*)expr;
+			return make<BinaryExpr>(copy(binary->left), binary->oper, copy(binary->right));
+		}
+		case ExprType::Get: {
+			GetExpr* get = (GetExpr*)expr;
+			return make<GetExpr>(copy(get->left), get->right);
+		}
+		default:
+			// Literals and names are never rewritten
+			return expr;
+		}
+	}
+
+	template<typename T, typename... Args>
+	T* make(Args&&... args) {
+		return program.arena.make<T>(std::forward<Args>(args)...);
+	}
+
+	Program& program;
+	size_t hoisted = 0;
+	size_t temporaries = 0;
+};
@@ -0,0 +1,138 @@
+#pragma once
+#include "pch.h"
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+
+// Read-only view over the whole contents of a file.
+// The file is memory mapped when possible, so the source is never copied;
+// if mapping fails it falls back to reading the file into memory.
+class MappedFile {
+public:
+	MappedFile() {}
+
+	MappedFile(fs::path path) {
+		open(path);
+	}
+
+	~MappedFile() {
+		close();
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	void open(fs::path path) {
+		close();
+		if (!map(path)) {
+			DEB("Could not map {}, reading instead", path.string());
+			fallback = readFile(path);
+			data = fallback.data();
+			size = fallback.size();
+		}
+	}
+
+	std::string_view view() const {
+		return { data, size };
+	}
+
+	bool isMapped() const {
+		return mapped;
+	}
+
+private:
+
+#ifdef _WIN32
+	bool map(const fs::path& path) {
+		file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			close();
+			return false;
+		}
+
+		mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) {
+			close();
+			return false;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!view) {
+			close();
+			return false;
+		}
+		data = (const char*)view;
+		size = (size_t)fileSize.QuadPart;
+		mapped = true;
+		return true;
+	}
+
+	void close() {
+		if (mapped) UnmapViewOfFile(data);
+		if (mapping) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+		reset();
+	}
+
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	bool map(const fs::path& path) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			::close(fd);
+			return false;
+		}
+
+		void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		// The mapping keeps its own reference to the file
+		::close(fd);
+		if (view == MAP_FAILED) return false;
+
+		madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+		data = (const char*)view;
+		size = (size_t)st.st_size;
+		mapped = true;
+		return true;
+	}
+
+	void close() {
+		if (mapped) munmap((void*)data, size);
+		reset();
+	}
+#endif
+
+	void reset() {
+		data = nullptr;
+		size = 0;
+		mapped = false;
+		fallback.clear();
+	}
+
+	const char* data = nullptr;
+	size_t size = 0;
+	bool mapped = false;
+	std::string fallback;
+};
@@ -2,29 +2,44 @@
 #include "Object.h"
 
 #include "Interpreter.h"
+#include "Parser.h"
+#include "Resolver.h"
+#include "Jit.h"
 
 Object* FuncObject::call(std::vector<Object*> arguments, Interpreter* interpreter)  {
+	Object* result;
+	if (interpreter->jit && interpreter->jit->call(this, arguments, interpreter, result)) {
+		return result;
+	}
 
 	if (params.size() != arguments.size()) {
 		ERR("Argument length not matching");
 	}
 
-	interpreter->env = new Environment{ interpreter->env };
+	interpreter->env = new Environment{ interpreter->env, params };
 	Environment* env = interpreter->env;
 	// Set parameters
-	for (size_t i = 0; i < params.size(); i++)
+	for (size_t i = 0; i < params.size() && i < arguments.size(); i++)
 	{
-		env->setValueForce(params[i].value, arguments[i]);
-	}
-	if (binding) {
-		env->setValueForce("self", binding);
+		env->slots[2 + i] = arguments[i];
 	}
+	env->slots[Environment::SelfSlot] = binding;
+	env->slots[Environment::RetvalSlot] = new NilObject{};
 
-	env->setValueForce("__retval__", new NilObject{});
-
-	interpreter->execute(body);
-	Object* retVal = env->getValue("__retval__");
-	env = env->parent;
+	if (flat) {
+		interpreter->execute(*flat, flatBody);
+	}
+	else if (decl->lazy) {
+		// Bodies parsed on the first call miss the Resolver's pass over the program
+		BlockStmt* body = Parser::body(decl);
+		Resolver::resolve(decl);
+		interpreter->execute(body);
+	}
+	else {
+		interpreter->execute(decl->body);
+	}
+	Object* retVal = env->slots[Environment::RetvalSlot];
+	interpreter->env = env->parent;
 
 	return retVal;
 
@@ -32,7 +47,7 @@ Object* FuncObject::call(std::vector<Object*> arguments, Interpreter* interprete
 
 Object* ClassObject::call(std::vector<Object*> arguments, Interpreter* interpreter){
 	ObjObject* obj = new ObjObject{ this };
-	Object* objInit = obj->getAttr("init");
+	Object* objInit = obj->getAttr(Symbols::Init);
 	if (objInit) {
 		objInit->call(arguments, interpreter);
 	}
@@ -3,10 +3,12 @@
 #include "Lexer.h"
 #include "Expression.h"
 #include "Statement.h"
+#include "FlatAst.h"
 
 // Objects
 class Interpreter;
 struct Environment; // Forward Decl
+struct JitCode;
 
 struct Object;
 
@@ -25,12 +27,12 @@ struct Object {
 		REF,
 	};
 	virtual Object::Type getType() = 0;
-	virtual Object* getAttr(std::string name) {
-		ERR("Illegal Get Attr {}", name);
+	virtual Object* getAttr(Symbol name) {
+		ERR("Illegal Get Attr {}", Symbols::name(name));
 		return nullptr;
 	}
-	virtual ObjRef getAttrRef(std::string name) {
-		ERR("Illegal Get Attr Ref {}", name);
+	virtual ObjRef getAttrRef(Symbol name) {
+		ERR("Illegal Get Attr Ref {}", Symbols::name(name));
 		return { nullptr };
 	}
 	virtual Object* call(std::vector<Object*> arguments, Interpreter* interpreter) {
@@ -53,14 +55,25 @@ struct FloatObject : public Object {
 };
 
 struct FuncObject : public Object {
-	std::vector<Token> params;
-	BlockStmt* body;
-	Object* binding;
+	NodeList<const Token> params;
+	// Body parsed on the first call when lazy
+	FuncDeclStmt* decl;
+	// Set instead of decl for functions declared in a flattened tree
+	const FlatAst* flat = nullptr;
+	StmtId flatBody{ FlatAst::None };
+	Object* binding = nullptr;
+	// Calls counted by the Jit, and the native code it made for the body
+	uint32_t calls = 0;
+	const JitCode* native = nullptr;
 
 	Type getType() override { return Type::FUNC; }
 
-	FuncObject(const std::vector<Token>& params, BlockStmt* body)
-		: params(params), body(body)
+	FuncObject(FuncDeclStmt* decl)
+		: params{ decl->params.items, decl->params.count }, decl(decl)
+	{
+	}
+	FuncObject(NodeList<const Token> params, const FlatAst* flat, StmtId flatBody)
+		: params(params), decl(nullptr), flat(flat), flatBody(flatBody)
 	{
 	}
 	Object* call(std::vector<Object*> arguments, Interpreter* interpreter)override;
@@ -69,16 +82,16 @@ struct FuncObject : public Object {
 
 
 struct ClassObject : public Object {
-	std::unordered_map<std::string, Object*> attrs;
+	std::unordered_map<Symbol, Object*> attrs;
 
 	Type getType() override { return Type::CLASS; }
 
 	ClassObject() {};
-	void addMethod(std::string name, FuncObject* funcObj) {
+	void addMethod(Symbol name, FuncObject* funcObj) {
 		attrs[name] = funcObj;
 	}
 
-	Object* getAttr(std::string name) override {
+	Object* getAttr(Symbol name) override {
 		if (attrs.count(name) != 0) {
 			Object* obj = attrs[name];
 			//if (obj->getType() == Object::Type::FUNC) {
@@ -87,14 +100,14 @@ struct ClassObject : public Object {
 			return attrs[name];
 		}
 		return nullptr;
-		//ERR("Illegal Get Attr {}", name);
+		//ERR("Illegal Get Attr {}", Symbols::name(name));
 	}
 
-	void setAttr(std::string name, Object* obj) {
+	void setAttr(Symbol name, Object* obj) {
 		attrs[name] = obj;
 	}
 
-	bool isAttr(std::string name) {
+	bool isAttr(Symbol name) {
 		return attrs.count(name) != 0;
 	}
 
@@ -107,14 +120,14 @@ struct ClassObject : public Object {
 
 struct ObjObject : public Object {
 	ClassObject* clsObj;
-	std::unordered_map<std::string, Object*> attrs;
+	std::unordered_map<Symbol, Object*> attrs;
 	Type getType() override { return Type::OBJ; }
 
 	ObjObject(ClassObject* _clsObj)
 		:clsObj(_clsObj) {
 	}
 
-	Object* getAttr(std::string name) override {
+	Object* getAttr(Symbol name) override {
 		if (attrs.count(name) != 0) {
 			return attrs[name];
 		}
@@ -126,7 +139,7 @@ struct ObjObject : public Object {
 		}
 		return clsAttr;
 	}
-	ObjRef getAttrRef(std::string name) override {
+	ObjRef getAttrRef(Symbol name) override {
 		if (attrs.count(name) != 0) {
 			return { &attrs[name] };
 		}
@@ -151,6 +164,6 @@ struct MethodObject : public Object {
 };
 
 struct AssignEnv {
-	std::unordered_map<std::string, Object*>* enclosing;
-	std::string name;
+	std::unordered_map<Symbol, Object*>* enclosing;
+	Symbol name;
 };
\ No newline at end of file
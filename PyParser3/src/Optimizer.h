@@ -0,0 +1,74 @@
+#pragma once
+#include "pch.h"
+#include "Program.h"
+#include "Inliner.h"
+#include "ConstantFolder.h"
+#include "DeadCodeEliminator.h"
+#include "LoopInvariantMotion.h"
+
+
+// Rewrites a parsed Program before it is run, without changing what it
+// does. Every pass can be turned off on its own.
+//
+// Runs on the tree as parsed, so a Program should be stored in the cache
+// before being optimized.
+class Optimizer {
+public:
+	struct Options {
+		bool inlineFunctions = true;
+		// Largest returned expression inlined, in nodes
+		size_t inlineMaxNodes = 16;
+		bool foldConstants = true;
+		bool removeDeadCode = true;
+		bool hoistInvariants = true;
+	};
+
+	struct Stats {
+		size_t inlinedCalls = 0;
+		size_t foldedNodes = 0;
+		size_t deadNodes = 0;
+		size_t hoistedExpressions = 0;
+
+		size_t removedNodes() const {
+			return foldedNodes + deadNodes;
+		}
+	};
+
+	Optimizer() = default;
+
+	Optimizer(Options _options)
+		: options(_options) {}
+
+	Stats run(Program& program) {
+		Stats stats;
+		// First, inlined arguments are often constant
+		if (options.inlineFunctions) {
+			Inliner inliner{ program, options.inlineMaxNodes };
+			inliner.run(program.statements);
+			stats.inlinedCalls = inliner.inlinedCalls();
+		}
+		if (options.foldConstants) {
+			ConstantFolder folder{ program };
+			folder.run(program.statements);
+			stats.foldedNodes = folder.removedNodes();
+		}
+		// After folding, which turns constant conditions into literals
+		if (options.removeDeadCode) {
+			DeadCodeEliminator eliminator{ program };
+			eliminator.run(program.statements);
+			stats.deadNodes = eliminator.removedNodes();
+		}
+		// Last, so only what is left of the loops is hoisted
+		if (options.hoistInvariants) {
+			LoopInvariantMotion motion{ program };
+			motion.run(program.statements);
+			stats.hoistedExpressions = motion.hoistedExpressions();
+		}
+		INFO("Optimizer inlined {} calls, removed {} nodes, hoisted {} expressions out of loops",
+			stats.inlinedCalls, stats.removedNodes(), stats.hoistedExpressions);
+		return stats;
+	}
+
+private:
+	Options options;
+};
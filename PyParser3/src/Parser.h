@@ -1,37 +1,406 @@
 #pragma once
 #include "pch.h"
 #include "Lexer.h"
+#include "TokenStream.h"
+#include "ThreadPool.h"
 #include "Expression.h"
 #include "Statement.h"
 #include "Object.h"
+#include "Program.h"
+#include "FlatAst.h"
+#include "Printer.h"
+
+
+// Binding strength of infix operators, loosest first
+enum class Prec : uint8_t {
+	None,
+	Assignment,	// =
+	Equality,	// == !=
+	Comparison,	// < <= > >=
+	Term,		// + -
+	Factor,		// * /
+};
+
+// Indexed by token type, None for tokens that are not infix operators
+inline constexpr std::array<Prec, (size_t)Token::Type::END + 1> infixPrecedences = [] {
+	std::array<Prec, (size_t)Token::Type::END + 1> table{};
+	table[(size_t)Token::Type::EQUAL] = Prec::Assignment;
+	table[(size_t)Token::Type::EQUAL_EQUAL] = Prec::Equality;
+	table[(size_t)Token::Type::BANG_EQUAL] = Prec::Equality;
+	table[(size_t)Token::Type::LESS] = Prec::Comparison;
+	table[(size_t)Token::Type::LESS_EQUAL] = Prec::Comparison;
+	table[(size_t)Token::Type::GREAT] = Prec::Comparison;
+	table[(size_t)Token::Type::GREAT_EQUAL] = Prec::Comparison;
+	table[(size_t)Token::Type::PLUS] = Prec::Term;
+	table[(size_t)Token::Type::MINUS] = Prec::Term;
+	table[(size_t)Token::Type::STAR] = Prec::Factor;
+	table[(size_t)Token::Type::DIV] = Prec::Factor;
+	return table;
+}();
+
+
+// A Program brought up to date with an edit of its source, see
+// Parser::reparse
+struct ReparseResult {
+	std::unique_ptr<Program> program;
+	// Top level functions, classes and assigned variables whose definition
+	// was added, removed or changed by the edit
+	std::vector<Symbol> changed;
+	// Top level statements carried over unchanged, and parsed again
+	size_t reused = 0;
+	size_t reparsed = 0;
+};
 
 
 class Parser {
 public:
-	Parser(std::vector<Token> _tokens) {
-		tokens = _tokens;
-		INFO("Starting Parsing");
+	enum class Mode {
+		// Parse the statements in order on the calling thread
+		Batch,
+		// Split large buffers between top level declarations and parse the
+		// pieces on the shared ThreadPool
+		Parallel,
+	};
+
+	enum class Bodies {
+		// Parse every function and method body up front
+		Eager,
+		// Only match the braces of a body and parse it when first needed,
+		// see body(). Syntax errors in a body show up once it is parsed.
+		Lazy,
+	};
+
+	Parser(std::vector<Token> _tokens, Mode _mode = Mode::Batch, Bodies _bodies = Bodies::Eager)
+		: tokens(std::move(_tokens)), mode(_mode), bodies(_bodies), program(std::make_unique<Program>()) {
+		run();
+	}
+
+	// Pulls tokens from the lexer while parsing instead of reading a
+	// fully lexed buffer
+	Parser(Lexer& lexer)
+		: tokens(&lexer), program(std::make_unique<Program>()) {
+		run();
+		program->errors += lexer.errors;
+	}
+
+	std::vector<Stmt*>& getStatements() {
+		return program->statements;
+	}
 
-		statements = parse();
+	// Owns the values of every literal in the statements
+	ConstantPool& getConstants() {
+		return program->constants;
+	}
 
-		DEB("Printing Representation");
-		for (Stmt* stmt: statements ) DEB(repr(stmt));
+	// Hands over the parsed program, which owns every node of the AST
+	std::unique_ptr<Program> takeProgram() {
+		return std::move(program);
 	}
 
-	std::vector<Stmt*>& getStatements() {
-		return statements;
+	// Body of `func`, parsed now if a lazy parse skipped it. Its nodes go
+	// to the Program that holds its tokens, and functions nested in it are
+	// skipped in turn.
+	static BlockStmt* body(FuncDeclStmt* func) {
+		if (!func->lazy) return func->body;
+		LazyBody lazy = *func->lazy;
+		Program& owner = *lazy.program;
+		// An END stands in for the token after the body while parsing it, so
+		// a malformed body cannot reach past where its braces matched
+		Token after = owner.tokens[lazy.end];
+		owner.tokens[lazy.end].type = Token::Type::END;
+		Parser parser{ BodyTag{}, owner, lazy.start };
+		func->body = parser.blockStatement();
+		func->lazy = nullptr;
+		owner.tokens = parser.tokens.takeBuffer();
+		owner.tokens[lazy.end] = after;
+		return func->body;
+	}
+
+	// Parses every body a lazy parse skipped, for passes that walk the
+	// whole tree
+	static void parseBodies(const std::vector<Stmt*>& statements) {
+		for (Stmt* stmt : statements) parseBodies(stmt);
+	}
+
+	static void parseBodies(Stmt* stmt) {
+		if (!stmt) return;
+		switch (stmt->type) {
+		case StmtType::BLOCK:
+			for (Stmt* inner : ((BlockStmt*)stmt)->stmts) parseBodies(inner);
+			break;
+		case StmtType::IF:
+			parseBodies(((IfStmt*)stmt)->thenStmt);
+			parseBodies(((IfStmt*)stmt)->elseStmt);
+			break;
+		case StmtType::WHILE:
+			parseBodies(((WhileStmt*)stmt)->main);
+			break;
+		case StmtType::FUNC_DECL:
+			parseBodies(body((FuncDeclStmt*)stmt));
+			break;
+		case StmtType::CLASS_DECL:
+			for (FuncDeclStmt* method : ((ClassDeclStmt*)stmt)->methods) parseBodies(method);
+			break;
+		default:
+			break;
+		}
+	}
+
+	// Parses `source`, which is `oldSource` after `edit`, reusing the top
+	// level statements of `previous` that the edit did not touch. Only the
+	// tokens around the edit are lexed again, and only the statements
+	// holding them are parsed again.
+	//
+	// The new program takes over `previous` to keep the reused nodes alive.
+	// Their token text is moved over to `source`, so `oldSource` may be
+	// dropped once this returns. Falls back to a full parse when `previous`
+	// kept no token buffer. Statements parsed again follow `bodies`.
+	static ReparseResult reparse(std::unique_ptr<Program> previous, std::string_view oldSource,
+		std::string_view source, SourceEdit edit, Bodies bodies = Bodies::Eager) {
+		ReparseResult result;
+		if (previous->tokens.empty()) {
+			result.program = Parser{ Lexer::fromSource(source).takeTokens(), Mode::Batch, bodies }.takeProgram();
+			result.reparsed = result.program->statements.size();
+			result.changed = changedNames(definitions(*previous, 0, previous->statements.size(), nullptr, 0),
+				definitions(*result.program, 0, result.reparsed, nullptr, 0));
+			return result;
+		}
+
+		RelexResult relexed = Lexer::relex(oldSource, std::move(previous->tokens), source, edit);
+		const std::vector<size_t>& oldEnds = previous->statementEnds;
+		size_t damageEnd = relexed.first + relexed.relexed;
+		ptrdiff_t delta = (ptrdiff_t)relexed.relexed - (ptrdiff_t)relexed.replaced;
+
+		// Statements ending before the first relexed token are kept, except
+		// the last of them, which the edit may extend (an else after an if)
+		size_t keep = 0;
+		while (keep < oldEnds.size() && oldEnds[keep] <= relexed.first) keep++;
+		if (keep > 0) keep--;
+
+		Parser parser{ ResumeTag{}, std::move(relexed.tokens), keep == 0 ? 0 : oldEnds[keep - 1] };
+		parser.bodies = bodies;
+		Program& program = *parser.program;
+		program.statements.assign(previous->statements.begin(), previous->statements.begin() + keep);
+		program.statementEnds.assign(oldEnds.begin(), oldEnds.begin() + keep);
+
+		// Parses until past the relexed tokens and at a place an old
+		// statement started, from where on the old statements still hold
+		size_t resume = oldEnds.size();
+		while (!parser.isEnd()) {
+			size_t position = parser.tokens.position();
+			if (position >= damageEnd) {
+				size_t old = (size_t)((ptrdiff_t)position - delta);
+				auto it = std::lower_bound(oldEnds.begin(), oldEnds.end(), old);
+				if (it != oldEnds.end() && *it == old) {
+					resume = (size_t)(it - oldEnds.begin()) + 1;
+					break;
+				}
+			}
+			program.statements.push_back(parser.statement());
+			program.statementEnds.push_back(parser.tokens.position());
+		}
+		size_t reparsedEnd = program.statements.size();
+		for (size_t i = resume; i < oldEnds.size(); i++) {
+			program.statements.push_back(previous->statements[i]);
+			program.statementEnds.push_back((size_t)((ptrdiff_t)oldEnds[i] + delta));
+		}
+		program.tokens = parser.tokens.takeBuffer();
+
+		// The old tokens of the replaced statements, put back together from
+		// the relexed buffer and the tokens relexing removed
+		size_t oldBegin = keep == 0 ? 0 : oldEnds[keep - 1];
+		size_t oldEnd = resume == keep ? oldBegin : oldEnds[resume - 1];
+		std::vector<Token> oldTokens;
+		for (size_t i = oldBegin; i < oldEnd; i++) {
+			if (i < relexed.first) oldTokens.push_back(program.tokens[i]);
+			else if (i < relexed.first + relexed.replaced) oldTokens.push_back(relexed.removed[i - relexed.first]);
+			else oldTokens.push_back(program.tokens[(size_t)((ptrdiff_t)i + delta)]);
+		}
+		result.changed = changedNames(definitions(*previous, keep, resume, oldTokens.data(), oldBegin),
+			definitions(program, keep, reparsedEnd, program.tokens.data(), 0));
+
+		SourceShift shift{ oldSource, source, edit, previous.get(), &program, 0, {} };
+		for (size_t i = 0; i < keep; i++) shift.rebase(program.statements[i]);
+		shift.tokenShift = delta;
+		for (size_t i = reparsedEnd; i < program.statements.size(); i++) shift.rebase(program.statements[i]);
+
+		result.reparsed = reparsedEnd - keep;
+		result.reused = program.statements.size() - result.reparsed;
+		DEB("Reparsed {} statements, reused {}", result.reparsed, result.reused);
+
+		// Only kept as storage for the reused nodes
+		previous->statements = {};
+		previous->statementEnds = {};
+		program.parts.push_back(std::move(previous));
+		result.program = std::move(parser.program);
+		return result;
+	}
+
+	// Representation of a flattened tree
+
+	static std::string repr(const FlatAst& ast, StmtId stmt) {
+		switch (ast.type(stmt)) {
+		case StmtType::BLOCK: {
+			std::string output = "( \n";
+			for (StmtId inner : ast.stmts(stmt)) {
+				output += repr(ast, inner);
+				output += "\n";
+			}
+			output += ");";
+			return output;
+		}
+		case StmtType::EXPRESSION:
+			return repr(ast, ast.expr(stmt)) + ";";
+		case StmtType::PRINT:
+			return std::string("PRINT ") + repr(ast, ast.expr(stmt));
+		case StmtType::IF: {
+			std::string output = std::string("IF ") + repr(ast, ast.condition(stmt)) + " " + repr(ast, ast.thenStmt(stmt));
+			if (ast.elseStmt(stmt).valid()) output += " ELSE " + repr(ast, ast.elseStmt(stmt));
+			return output;
+		}
+		case StmtType::WHILE:
+			return std::string("WHILE ") + repr(ast, ast.condition(stmt)) + " " + repr(ast, ast.body(stmt));
+		case StmtType::FUNC_DECL: {
+			std::string output = "FUN " + std::string(Symbols::name(ast.name(stmt))) + "(";
+			for (const Token& param : ast.params(stmt)) {
+				if (output.back() != '(') output += ", ";
+				output += param.value;
+			}
+			return output + ") " + repr(ast, ast.body(stmt));
+		}
+		case StmtType::RETURN:
+			return ast.expr(stmt).valid() ? std::string("RETURN ") + repr(ast, ast.expr(stmt)) + ";" : "RETURN;";
+		case StmtType::CLASS_DECL:
+			return "CLASS DECL;";
+		}
+		return "UNKNOWN STMT;";
+	}
+
+	static std::string repr(const FlatAst& ast, ExprId expr) {
+		if (!expr.valid()) return "(ERR NULL EXPR)";
+		switch (ast.type(expr)) {
+		case ExprType::Literal:
+			return std::string(ast.literalText(expr));
+		case ExprType::Identifier:
+			return std::string(Symbols::name(ast.symbol(expr)));
+		case ExprType::Unary:
+			return std::string("( ") + Printer::operText(ast.oper(expr)) + " " + repr(ast, ast.operand(expr)) + " )";
+		case ExprType::Binary:
+			return std::string("( ") + Printer::operText(ast.oper(expr)) + " " + repr(ast, ast.left(expr)) + " " + repr(ast, ast.right(expr)) + " )";
+		case ExprType::Assign:
+			return repr(ast, ast.left(expr)) + " = " + repr(ast, ast.value(expr));
+		case ExprType::FuncCall: {
+			std::string output = repr(ast, ast.callee(expr)) + "(";
+			for (ExprId arg : ast.args(expr)) {
+				if (output.back() != '(') output += ", ";
+				output += repr(ast, arg);
+			}
+			return output + ")";
+		}
+		case ExprType::Get:
+			return repr(ast, ast.left(expr)) + "." + std::string(Symbols::name(ast.symbol(expr)));
+		}
+		return "(UNKNOWN EXPR)";
 	}
 
 private:
+
+	void run() {
+		INFO("Starting Parsing");
+
+		program->statements = mode == Mode::Parallel ? parseParallel() : parse();
+		program->tokens = tokens.takeBuffer();
+		DEB("Allocated {} bytes of AST in {} blocks", program->arena.bytesAllocated(), program->arena.blockCount());
+
+		// repr() is expensive, only build it when it will be printed
+		if (spdlog::should_log(spdlog::level::debug)) {
+			DEB("Printing Representation");
+			for (Stmt* stmt: program->statements ) DEB(Printer::repr(stmt));
+		}
+	}
 	
 	std::vector<Stmt*> parse() {
 		std::vector<Stmt*> statements;
 		while (!isEnd()) {
 			statements.push_back(statement());
+			program->statementEnds.push_back(tokens.position());
 		}
 		return statements;
 	}
 
+	// Gives the same statements as parse(), in the same order. Every piece
+	// is parsed into a Program of its own, kept as a part of this one.
+	std::vector<Stmt*> parseParallel() {
+		const std::vector<Token>& all = tokens.buffer();
+		ThreadPool& pool = ThreadPool::shared();
+		size_t chunkCount = std::min(pool.size(), all.size() / MinChunkTokens);
+		if (chunkCount < 2) {
+			return parse();
+		}
+
+		std::vector<size_t> cuts = chunkBoundaries(all, chunkCount);
+		if (cuts.size() < 3) {
+			return parse();
+		}
+
+		std::vector<std::future<std::unique_ptr<Program>>> chunks;
+		for (size_t i = 1; i < cuts.size(); i++) {
+			size_t begin = cuts[i - 1];
+			size_t end = cuts[i];
+			chunks.push_back(pool.submit([&all, begin, end, bodies = bodies] {
+				std::vector<Token> slice;
+				slice.reserve(end - begin + 1);
+				slice.insert(slice.end(), all.begin() + begin, all.begin() + end);
+				slice.push_back(all.back());
+				Parser part{ PartTag{}, std::move(slice), bodies };
+				return std::move(part.program);
+			}));
+		}
+
+		std::vector<Stmt*> statements;
+		for (size_t i = 0; i < chunks.size(); i++) {
+			program->parts.push_back(chunks[i].get());
+			const Program& part = *program->parts.back();
+			program->errors += part.errors;
+			statements.insert(statements.end(), part.statements.begin(), part.statements.end());
+			for (size_t end : part.statementEnds) {
+				program->statementEnds.push_back(cuts[i] + end);
+			}
+		}
+		DEB("Parsed {} chunks on {} threads", chunks.size(), pool.size());
+		return statements;
+	}
+
+	// Token indices cutting the buffer into about `count` runs of whole top
+	// level statements, starting with 0 and ending at the END token. Without
+	// parsing, the only place known to start a statement is a fun or class
+	// declaration outside of any braces that follows a finished statement,
+	// so the buffer is only cut there.
+	static std::vector<size_t> chunkBoundaries(const std::vector<Token>& all, size_t count) {
+		size_t end = all.size() - 1;
+		size_t target = end / count;
+		std::vector<size_t> cuts{ 0 };
+		size_t depth = 0;
+		for (size_t i = 0; i < end; i++) {
+			Token::Type type = all[i].type;
+			if (type == Token::Type::L_BRACE) {
+				depth++;
+			}
+			else if (type == Token::Type::R_BRACE) {
+				if (depth > 0) depth--;
+			}
+			else if (depth == 0 && (type == Token::Type::FUN || type == Token::Type::CLASS) &&
+				i - cuts.back() >= target && cuts.size() < count) {
+				Token::Type previous = all[i - 1].type;
+				if (previous == Token::Type::SEMICOLON || previous == Token::Type::R_BRACE) {
+					cuts.push_back(i);
+				}
+			}
+		}
+		cuts.push_back(end);
+		return cuts;
+	}
+
 	// Parse Statement
 
 	Stmt* statement() {
@@ -68,18 +437,39 @@ private:
 		Token name = peek(-1);
 		match(Token::Type::L_PAREN);
 		
-		std::vector<Token> params;
+		size_t base = paramStack.size();
 		if (!check(Token::Type::R_PAREN)) {
 			do {
 				match(Token::Type::IDENTIFIER);
-				params.push_back(peek(-1));
+				paramStack.push_back(peek(-1));
 			} while (match(Token::Type::COMMA));
 		}
+		NodeList<Token> params = finishList(paramStack, base);
 		match(Token::Type::R_PAREN);
 		match(Token::Type::L_BRACE);
+		if (bodies == Bodies::Lazy) {
+			return make<FuncDeclStmt>(name, params, nullptr, skipBody());
+		}
 		BlockStmt* body = (BlockStmt*)blockStatement();
-		return new FuncDeclStmt{ name, params, body };
+		return make<FuncDeclStmt>(name, params, body);
+
+	}
 
+	// Steps past the closing brace of a body, only matching braces
+	LazyBody* skipBody() {
+		size_t start = tokens.position();
+		size_t depth = 0;
+		while (!isEnd()) {
+			Token::Type type = advance().type;
+			if (type == Token::Type::L_BRACE) {
+				depth++;
+			}
+			else if (type == Token::Type::R_BRACE) {
+				if (depth == 0) break;
+				depth--;
+			}
+		}
+		return make<LazyBody>(LazyBody{ target, start, tokens.position() });
 	}
 	
 	ReturnStmt* returnStatement() {
@@ -88,7 +478,7 @@ private:
 			expr = expression();
 		}
 		match(Token::Type::SEMICOLON);
-		return new ReturnStmt{ expr };
+		return make<ReturnStmt>(expr);
 	}
 
 	ClassDeclStmt* classDeclStatement() {
@@ -96,34 +486,36 @@ private:
 		Token name = peek(-1);
 		
 		match(Token::Type::L_BRACE);
-		std::vector<FuncDeclStmt*> methods;
-		while (!check(Token::Type::R_BRACE)) {
+		size_t base = methodStack.size();
+		while (!check(Token::Type::R_BRACE) && !isEnd()) {
 			match(Token::Type::FUN);
-			methods.push_back(funcDeclStatement());
+			FuncDeclStmt* method = funcDeclStatement();
+			methodStack.push_back(method);
 		}
 		match(Token::Type::R_BRACE);
-		return new ClassDeclStmt{ name, methods };
+		return make<ClassDeclStmt>(name, finishList(methodStack, base));
 
 	}
 
 	BlockStmt* blockStatement() {
-		std::vector<Stmt*> stmts;
-		while (!match(Token::Type::R_BRACE)) {
-			stmts.push_back(statement());
+		size_t base = stmtStack.size();
+		while (!match(Token::Type::R_BRACE) && !isEnd()) {
+			Stmt* stmt = statement();
+			stmtStack.push_back(stmt);
 		}
-		return new BlockStmt(stmts);
+		return make<BlockStmt>(finishList(stmtStack, base));
 	}
 
 	PrintStmt* printStatement() {
 		Expr* expr = expression();
 		match(Token::Type::SEMICOLON);
-		return new PrintStmt(expr);
+		return make<PrintStmt>(expr);
 	}
 
 	ExprStmt* exprStatement() {
 		Expr* expr = expression();
 		match(Token::Type::SEMICOLON);
-		return new ExprStmt(expr);
+		return make<ExprStmt>(expr);
 
 	}
 
@@ -136,7 +528,7 @@ private:
 		if (match(Token::Type::ELSE)) {
 			elseStmt = statement();
 		}
-		return new IfStmt{ condition, thenStmt, elseStmt };
+		return make<IfStmt>(condition, thenStmt, elseStmt);
 	}
 
 	WhileStmt* whileStatement() {
@@ -144,91 +536,64 @@ private:
 		Expr* condition = expression();
 		match(Token::Type::R_PAREN);
 		Stmt* mainStmt = statement();
-		return new WhileStmt{ condition, mainStmt};
+		return make<WhileStmt>(condition, mainStmt);
 	}
 
 
 	// Grammar
 	
-	// expression -> assignment
-	// assignment -> equality ["=" assignment]
-	// equality -> comparison (("!=" | "==") comparison)*
-	// comparsion -> term ( (">" | ">=" | "<" | "<=") term)*
-	// term -> factor (("+" | "-") factor)*
-	// factor -> unary (("*" | "/") unary)*
-	// unary -> ( "!" | "-") unary | call 
-	// call -> primary "(" [expression ("," expression)*] ")"
+	// expression -> prefix (infix-operator expression)*
+	// prefix -> ( "!" | "-") prefix | call
+	// call -> primary ( "(" [expression ("," expression)*] ")" )*
 	// primary -> INTEGER 
 	//			| IDENTIFIER ( "." IDENTIFIER)*
 	//			| "(" expression ")"
+	//
+	// Infix operators are parsed by precedence climbing over
+	// infixPrecedences. Assignment is right associative, everything else left.
 	
 	// Parse Expression
 
 	Expr* expression() {
-		return assignment();
+		return expression(Prec::Assignment);
 	}
 
-	Expr* assignment() {
-		Expr* expr = equality();
-		if (match(Token::Type::EQUAL)) {
-			//Token equal = peek(-1);
-			Expr* value = assignment();
-			if (expr->type == ExprType::Identifier ||
-				expr->type == ExprType::Get) {
-				return new AssignExpr(expr, value);
-			}
-			else {
-				std::cout << "Invalid Assignment Target" << std::endl;
-			}
-		}
-		return expr;
-	}
+	// Parses an operand followed by every infix operator binding at least
+	// as tightly as `min`
+	Expr* expression(Prec min) {
+		Expr* expr = prefix();
 
-	Expr* equality() {
-		Expr* expr = comparison();
-		while (match({ Token::Type::BANG_EQUAL , Token::Type::EQUAL_EQUAL })) {
-			Token oper = peek(-1);
-			Expr* right = comparison();
-			expr = new BinaryExpr(expr, oper, right);
-		}
-		return expr;
-	}
-
-	Expr* comparison() {
-		Expr* expr = term();
-		while (match({ Token::Type::GREAT , Token::Type::GREAT_EQUAL, Token::Type::LESS, Token::Type::LESS_EQUAL })) {
-			Token oper = peek(-1);
-			Expr* right = term();
-			expr = new BinaryExpr(expr, oper, right);
-		}
-		return expr;
-	}
-
-	Expr* term() {
-		Expr* expr = factor();
-		while (match({ Token::Type::PLUS , Token::Type::MINUS })) {
-			Token oper = peek(-1);
-			Expr* right = factor();
-			expr = new BinaryExpr(expr, oper, right);
-		}
-		return expr;
-	}
+		while (true) {
+			Prec prec = infixPrecedences[(size_t)peek().type];
+			if (prec == Prec::None || prec < min) break;
+			// Copied, the stream window moves on while the operand is parsed
+			Token oper = advance();
+
+			if (prec == Prec::Assignment) {
+				Expr* value = expression(Prec::Assignment);
+				if (expr && (expr->type == ExprType::Identifier ||
+					expr->type == ExprType::Get)) {
+					expr = make<AssignExpr>(expr, value);
+				}
+				else {
+					std::cout << "Invalid Assignment Target" << std::endl;
+					target->errors++;
+				}
+				continue;
+			}
 
-	Expr* factor() {
-		Expr* expr = unary();
-		while (match({ Token::Type::STAR, Token::Type::DIV })) {
-			Token oper = peek(-1);
-			Expr* right = unary();
-			expr = new BinaryExpr(expr, oper, right);
+			Expr* right = expression((Prec)((uint8_t)prec + 1));
+			expr = make<BinaryExpr>(expr, oper, right);
 		}
 		return expr;
 	}
 
-	Expr* unary() {
-		if (match({ Token::Type::BANG, Token::Type::MINUS })) {
-			Token oper = peek(-1);
-			Expr* right = unary();
-			return new UnaryExpr(oper, right);
+	Expr* prefix() {
+		Token::Type type = peek().type;
+		if (type == Token::Type::BANG || type == Token::Type::MINUS) {
+			Token oper = advance();
+			Expr* right = prefix();
+			return make<UnaryExpr>(oper, right);
 		}
 		return call();
 	}
@@ -246,24 +611,31 @@ private:
 	}
 
 	Expr* finishCall(Expr* name) {
-		std::vector<Expr*> args;
+		size_t base = exprStack.size();
 		if (!check(Token::Type::R_PAREN)) {
 			do {
-				args.push_back(expression());
+				Expr* arg = expression();
+				exprStack.push_back(arg);
 			} while (match(Token::Type::COMMA));
 		}
 		match(Token::Type::R_PAREN);
-		return new FuncCallExpr(name, args);
+		return make<FuncCallExpr>(name, finishList(exprStack, base));
 	}
 
 	Expr* primary() {
 		if (match(Token::Type::INTEGER)) {
-			return new LiteralExpr(peek(-1));
+			Token literal = peek(-1);
+			FloatObject* value = target->constants.decode(literal.value);
+			if (!value) {
+				target->errors++;
+				value = target->constants.get(0);
+			}
+			return make<LiteralExpr>(literal, value);
 		}
 		if (match(Token::Type::IDENTIFIER)) {
-			Expr* expr = new IdentifierExpr{ peek(-1) };
+			Expr* expr = make<IdentifierExpr>(peek(-1));
 			while (match(Token::Type::DOT)) {
-				expr = new GetExpr(expr,  peek());
+				expr = make<GetExpr>(expr,  peek());
 				advance();
 			}
 			return expr;
@@ -271,140 +643,285 @@ private:
 		if (match(Token::Type::L_PAREN)) {
 			Expr* expr = expression();
 			match(Token::Type::R_PAREN);
+			return expr;
 		}
+		ERR("Expected expression");
+		target->errors++;
+		// Skip the offending token, so a broken script still gets parsed to the end
+		if (!isEnd()) advance();
+		return nullptr;
 	}
 
-	// Print Representation
+	// Utilities
 
-	std::string repr(Stmt* stmt) {
-		switch (stmt->type) {
-		case StmtType::BLOCK:
-			return repr((BlockStmt*)stmt);
-		case StmtType::EXPRESSION:
-			return repr((ExprStmt*)stmt);
-		case StmtType::CLASS_DECL:
-			return repr((ClassDeclStmt*)stmt);
-		case StmtType::PRINT:
-			return repr((PrintStmt*)stmt);
-		default:
-			return "UNKNOWN STMT;";
-		}
+	template<typename T, typename... Args>
+	T* make(Args&&... args) {
+		return target->arena.make<T>(std::forward<Args>(args)...);
 	}
 
-	std::string repr(PrintStmt* stmt) {
-		return std::string("PRINT ") + repr(stmt->expr) ;
-
-	}
-	std::string repr(BlockStmt* stmt) {
-		std::string output = "( \n";
-		for (Stmt* _stmt : stmt->stmts) {
-			output += repr(_stmt);
-			output += "\n";
-		}
-		output += ");";
-		return output;
+	// Lists are gathered on a stack shared by every nesting level, and moved
+	// into the arena once complete
+	template<typename T>
+	NodeList<T> finishList(std::vector<T>& stack, size_t base) {
+		NodeList<T> list = target->arena.list(stack.data() + base, stack.size() - base);
+		stack.resize(base);
+		return list;
 	}
 
-	std::string repr(ExprStmt* stmt) {
-		return repr(stmt->expr) + ";";
+	bool check(Token::Type type) {
+		return peek().type == type;
 	}
 
-	std::string repr(ClassDeclStmt* stmt) {
-		return "CLASS DECL;";
+	bool match(Token::Type type) {
+		if (check(type)) {
+			advance();
+			return true;
+		}
+		return false;
 	}
 
-	std::string repr(Expr* expr) {
-		if (!expr) return "(ERR NULL EXPR)";
-		switch (expr->type)
-		{
-		case ExprType::Literal:
-			return repr((LiteralExpr*)expr);
-			//case ExprType::Unary:
-				//return reprUnary((UnaryExpr*)expr)
-		case ExprType::Binary:
-			return repr((BinaryExpr*)expr);
-		case ExprType::Assign:
-			return repr((AssignExpr*)expr);
-		case ExprType::Get:
-			return repr((GetExpr*)expr);
-		case ExprType::Identifier:
-			return repr((IdentifierExpr*)expr);
 
-		default:
-			return "(UNKNOWN EXPR)";
-		}
+	const Token& advance() {
+		return tokens.advance();
 	}
-	std::string repr(IdentifierExpr* expr) {
-		return expr->token.value;
+	
+	const Token& peek() {
+		return peek(0);
 	}
-	std::string repr(GetExpr* expr) {
-		return repr(expr->left) + "." + expr->right.value;
+	const Token& peek(int offset) {
+		return tokens.peek(offset);
 	}
+	
+	bool isEnd() {
+		return peek().type == Token::Type::END;
+	}
+	
+private:
+
 
-	std::string repr(AssignExpr* expr) {
-		return repr(expr->left) + " = " + repr(expr->value);
+	struct PartTag {};
+	struct ResumeTag {};
+	struct BodyTag {};
+
+	// Parses nothing by itself, statements are pulled one by one from `start`
+	Parser(ResumeTag, std::vector<Token> _tokens, size_t start)
+		: tokens(std::move(_tokens)), program(std::make_unique<Program>()) {
+		tokens.seek(start);
 	}
 
-	std::string repr(LiteralExpr* expr) {
-		return expr->token.value;
+	// Parses into `owner`, borrowing its token buffer from `start` on until
+	// handed back with takeBuffer()
+	Parser(BodyTag, Program& owner, size_t start)
+		: tokens(std::move(owner.tokens)), bodies(Bodies::Lazy), target(&owner) {
+		tokens.seek(start);
 	}
-	
-	std::string repr(BinaryExpr* expr) {
-		std::string operStr;
-		switch (expr->oper.type)
-		{
-		case Token::Type::PLUS:
-			operStr = "+";
-
-		case Token::Type::MINUS:
-			operStr = "+";
-		default:
-			break;
+
+	// Incremental reparsing
+
+	// Moves token text of nodes outside of an edit from the old source to
+	// the same text in the new one. Lazy bodies in the buffer of `from`
+	// move to the buffer of `to`, `tokenShift` tokens further along.
+	struct SourceShift {
+		std::string_view oldSource;
+		std::string_view source;
+		SourceEdit edit;
+		Program* from;
+		Program* to;
+		ptrdiff_t tokenShift = 0;
+		// Other programs lazy bodies were found in, with their tokens moved
+		std::unordered_set<Program*> moved;
+
+		void rebase(LazyBody& lazy) {
+			if (lazy.program == from) {
+				lazy.program = to;
+				lazy.start = (size_t)((ptrdiff_t)lazy.start + tokenShift);
+				lazy.end = (size_t)((ptrdiff_t)lazy.end + tokenShift);
+			}
+			else if (moved.insert(lazy.program).second) {
+				for (Token& token : lazy.program->tokens) rebase(token);
+			}
 		}
-		return std::string("( ") + operStr + " " + repr(expr->left) + " " + repr(expr->right) + " )";
-	}
 
-	// Utilities
+		void rebase(Token& token) const {
+			const char* text = token.value.data();
+			if (text < oldSource.data() || text > oldSource.data() + oldSource.size()) return;
+			size_t offset = (size_t)(text - oldSource.data());
+			if (offset >= edit.offset + edit.removed) offset = offset + edit.inserted - edit.removed;
+			token.value = source.substr(offset, token.value.size());
+		}
 
-	bool check(Token::Type type) {
-		return peek().type == type;
-	}
+		void rebase(Stmt* stmt) {
+			if (!stmt) return;
+			switch (stmt->type) {
+			case StmtType::BLOCK:
+				for (Stmt* inner : ((BlockStmt*)stmt)->stmts) rebase(inner);
+				break;
+			case StmtType::EXPRESSION:
+				rebase(((ExprStmt*)stmt)->expr);
+				break;
+			case StmtType::PRINT:
+				rebase(((PrintStmt*)stmt)->expr);
+				break;
+			case StmtType::IF:
+				rebase(((IfStmt*)stmt)->condition);
+				rebase(((IfStmt*)stmt)->thenStmt);
+				rebase(((IfStmt*)stmt)->elseStmt);
+				break;
+			case StmtType::WHILE:
+				rebase(((WhileStmt*)stmt)->condition);
+				rebase(((WhileStmt*)stmt)->main);
+				break;
+			case StmtType::FUNC_DECL: {
+				FuncDeclStmt* func = (FuncDeclStmt*)stmt;
+				rebase(func->name);
+				for (Token& param : func->params) rebase(param);
+				if (func->lazy) rebase(*func->lazy);
+				else rebase(func->body);
+				break;
+			}
+			case StmtType::RETURN:
+				rebase(((ReturnStmt*)stmt)->retVal);
+				break;
+			case StmtType::CLASS_DECL: {
+				ClassDeclStmt* cls = (ClassDeclStmt*)stmt;
+				rebase(cls->name);
+				for (FuncDeclStmt* method : cls->methods) rebase(method);
+				break;
+			}
+			}
+		}
 
-	bool match(Token::Type type) {
-		return match(std::vector<Token::Type>{ type });
-	}
-	bool match(std::vector<Token::Type> types) {
-		for (Token::Type type : types) {	
-			if (check(type)) {
-				advance();
-				return true;
+		void rebase(Expr* expr) const {
+			if (!expr) return;
+			switch (expr->type) {
+			case ExprType::Literal:
+				rebase(((LiteralExpr*)expr)->token);
+				break;
+			case ExprType::Identifier:
+				rebase(((IdentifierExpr*)expr)->token);
+				break;
+			case ExprType::Unary:
+				rebase(((UnaryExpr*)expr)->oper);
+				rebase(((UnaryExpr*)expr)->right);
+				break;
+			case ExprType::Binary:
+				rebase(((BinaryExpr*)expr)->left);
+				rebase(((BinaryExpr*)expr)->oper);
+				rebase(((BinaryExpr*)expr)->right);
+				break;
+			case ExprType::Assign:
+				rebase(((AssignExpr*)expr)->left);
+				rebase(((AssignExpr*)expr)->value);
+				break;
+			case ExprType::FuncCall:
+				rebase(((FuncCallExpr*)expr)->name);
+				for (Expr* arg : ((FuncCallExpr*)expr)->args) rebase(arg);
+				break;
+			case ExprType::Get:
+				rebase(((GetExpr*)expr)->left);
+				rebase(((GetExpr*)expr)->right);
+				break;
 			}
 		}
-		return false;
-	}
+	};
 
+	// A top level statement defining a name, with its tokens when known
+	struct Definition {
+		Symbol name;
+		const Token* begin;
+		const Token* end;
+	};
 
-	Token advance() {
-		return tokens[idx++];
-	}
-	
-	Token peek() {
-		return peek(0);
+	// Name defined by a top level function, class or variable assignment
+	static Symbol definedName(Stmt* stmt) {
+		switch (stmt->type) {
+		case StmtType::FUNC_DECL:
+			return ((FuncDeclStmt*)stmt)->name.symbol;
+		case StmtType::CLASS_DECL:
+			return ((ClassDeclStmt*)stmt)->name.symbol;
+		case StmtType::EXPRESSION: {
+			Expr* expr = ((ExprStmt*)stmt)->expr;
+			if (expr && expr->type == ExprType::Assign && ((AssignExpr*)expr)->left->type == ExprType::Identifier) {
+				return ((IdentifierExpr*)((AssignExpr*)expr)->left)->token.symbol;
+			}
+			return Symbols::None;
+		}
+		default:
+			return Symbols::None;
+		}
 	}
-	Token peek (int offset){
-		return tokens[idx+ offset];
+
+	// Definitions made by statements [begin, end) of `program`. `tokens`
+	// holds the program's tokens from index `tokenBase` on, or is null.
+	static std::vector<Definition> definitions(const Program& program, size_t begin, size_t end,
+		const Token* tokens, size_t tokenBase) {
+		std::vector<Definition> found;
+		for (size_t i = begin; i < end; i++) {
+			Symbol name = definedName(program.statements[i]);
+			if (name == Symbols::None) continue;
+			if (!tokens) {
+				found.push_back({ name, nullptr, nullptr });
+				continue;
+			}
+			size_t first = i == 0 ? 0 : program.statementEnds[i - 1];
+			found.push_back({ name, tokens + (first - tokenBase), tokens + (program.statementEnds[i] - tokenBase) });
+		}
+		// Stable, so redefinitions of one name stay in source order
+		std::stable_sort(found.begin(), found.end(), [](const Definition& a, const Definition& b) { return a.name < b.name; });
+		return found;
+	}
+
+	// Names whose definitions differ in number or in token text. Without
+	// tokens every definition counts as changed.
+	static std::vector<Symbol> changedNames(const std::vector<Definition>& before, const std::vector<Definition>& after) {
+		auto sameText = [](const Definition& a, const Definition& b) {
+			if (!a.begin || !b.begin) return false;
+			return std::equal(a.begin, a.end, b.begin, b.end, [](const Token& x, const Token& y) {
+				return x.type == y.type && x.value == y.value;
+			});
+		};
+
+		std::vector<Symbol> changed;
+		size_t i = 0, j = 0;
+		while (i < before.size() || j < after.size()) {
+			Symbol name = j == after.size() || (i < before.size() && before[i].name < after[j].name) ? before[i].name : after[j].name;
+			size_t beforeEnd = i, afterEnd = j;
+			while (beforeEnd < before.size() && before[beforeEnd].name == name) beforeEnd++;
+			while (afterEnd < after.size() && after[afterEnd].name == name) afterEnd++;
+
+			bool same = beforeEnd - i == afterEnd - j;
+			for (size_t k = 0; same && k < beforeEnd - i; k++) {
+				same = sameText(before[i + k], after[j + k]);
+			}
+			if (!same) changed.push_back(name);
+			i = beforeEnd;
+			j = afterEnd;
+		}
+		return changed;
 	}
-	
-	bool isEnd() {
-		return peek().type == Token::Type::END;
+
+	// One piece of a parallel parse, parsed without the logging of run()
+	Parser(PartTag, std::vector<Token> _tokens, Bodies _bodies)
+		: tokens(std::move(_tokens)), bodies(_bodies), program(std::make_unique<Program>()) {
+		program->statements = parse();
+		// Lazy bodies are parsed from the piece's own tokens
+		if (bodies == Bodies::Lazy) program->tokens = tokens.takeBuffer();
 	}
-	
-private:
 
+	// Fewest tokens worth handing to another thread
+	static constexpr size_t MinChunkTokens = 1 << 16;
+
+	TokenStream tokens;
+	Mode mode = Mode::Batch;
+	Bodies bodies = Bodies::Eager;
+	std::unique_ptr<Program> program;
+	// Where nodes are allocated, the parsed program unless parsing a lazy body
+	Program* target = program.get();
 
-	int idx = 0;
-	std::vector<Token> tokens;
-	std::vector<Stmt*> statements;
+	std::vector<Stmt*> stmtStack;
+	std::vector<Expr*> exprStack;
+	std::vector<Token> paramStack;
+	std::vector<FuncDeclStmt*> methodStack;
 };
 
 
@@ -0,0 +1,131 @@
+#pragma once
+#include "pch.h"
+#include "Expression.h"
+#include "Statement.h"
+#include "Visitor.h"
+
+
+// Text of a tree, in the same form Parser::repr gives a flattened one
+class Printer : public ExprVisitor<Printer, std::string>, public StmtVisitor<Printer, std::string> {
+	friend ExprVisitor<Printer, std::string>;
+	friend StmtVisitor<Printer, std::string>;
+public:
+	static std::string repr(Stmt* stmt) {
+		return Printer{}.print(stmt);
+	}
+
+	static std::string repr(Expr* expr) {
+		return Printer{}.print(expr);
+	}
+
+	static const char* operText(Token::Type type) {
+		switch (type) {
+		case Token::Type::PLUS: return "+";
+		case Token::Type::MINUS: return "-";
+		case Token::Type::STAR: return "*";
+		case Token::Type::DIV: return "/";
+		case Token::Type::BANG: return "!";
+		case Token::Type::BANG_EQUAL: return "!=";
+		case Token::Type::EQUAL_EQUAL: return "==";
+		case Token::Type::LESS: return "<";
+		case Token::Type::LESS_EQUAL: return "<=";
+		case Token::Type::GREAT: return ">";
+		case Token::Type::GREAT_EQUAL: return ">=";
+		default: return "?";
+		}
+	}
+
+private:
+	std::string print(Stmt* stmt) {
+		if (!stmt) return "(ERR NULL STMT)";
+		return StmtVisitor::visit(stmt);
+	}
+
+	std::string print(Expr* expr) {
+		if (!expr) return "(ERR NULL EXPR)";
+		return ExprVisitor::visit(expr);
+	}
+
+	// Statements
+
+	std::string visitBlock(BlockStmt* stmt) {
+		std::string output = "( \n";
+		for (Stmt* inner : stmt->stmts) {
+			output += print(inner);
+			output += "\n";
+		}
+		output += ");";
+		return output;
+	}
+
+	std::string visitExpression(ExprStmt* stmt) {
+		return print(stmt->expr) + ";";
+	}
+
+	std::string visitPrint(PrintStmt* stmt) {
+		return std::string("PRINT ") + print(stmt->expr);
+	}
+
+	std::string visitIf(IfStmt* stmt) {
+		std::string output = std::string("IF ") + print(stmt->condition) + " " + print(stmt->thenStmt);
+		if (stmt->elseStmt) output += " ELSE " + print(stmt->elseStmt);
+		return output;
+	}
+
+	std::string visitWhile(WhileStmt* stmt) {
+		return std::string("WHILE ") + print(stmt->condition) + " " + print(stmt->main);
+	}
+
+	std::string visitFuncDecl(FuncDeclStmt* stmt) {
+		std::string output = "FUN " + std::string(Symbols::name(stmt->name.symbol)) + "(";
+		for (const Token& param : stmt->params) {
+			if (output.back() != '(') output += ", ";
+			output += param.value;
+		}
+		// Not parsed yet when lazy
+		return output + ") " + (stmt->body ? print((Stmt*)stmt->body) : std::string("( ... );"));
+	}
+
+	std::string visitReturn(ReturnStmt* stmt) {
+		return stmt->retVal ? std::string("RETURN ") + print(stmt->retVal) + ";" : "RETURN;";
+	}
+
+	std::string visitClassDecl(ClassDeclStmt*) {
+		return "CLASS DECL;";
+	}
+
+	// Expressions
+
+	std::string visitLiteral(LiteralExpr* expr) {
+		return std::string(expr->token.value);
+	}
+
+	std::string visitIdentifier(IdentifierExpr* expr) {
+		return std::string(Symbols::name(expr->token.symbol));
+	}
+
+	std::string visitUnary(UnaryExpr* expr) {
+		return std::string("( ") + operText(expr->oper.type) + " " + print(expr->right) + " )";
+	}
+
+	std::string visitBinary(BinaryExpr* expr) {
+		return std::string("( ") + operText(expr->oper.type) + " " + print(expr->left) + " " + print(expr->right) + " )";
+	}
+
+	std::string visitAssign(AssignExpr* expr) {
+		return print(expr->left) + " = " + print(expr->value);
+	}
+
+	std::string visitFuncCall(FuncCallExpr* expr) {
+		std::string output = print(expr->name) + "(";
+		for (Expr* arg : expr->args) {
+			if (output.back() != '(') output += ", ";
+			output += print(arg);
+		}
+		return output + ")";
+	}
+
+	std::string visitGet(GetExpr* expr) {
+		return print(expr->left) + "." + std::string(Symbols::name(expr->right.symbol));
+	}
+};
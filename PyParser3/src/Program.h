@@ -0,0 +1,29 @@
+#pragma once
+#include "pch.h"
+#include "Arena.h"
+#include "ConstantPool.h"
+#include "MappedFile.h"
+#include "Statement.h"
+
+
+// A parsed script. Owns every node of its AST and every literal value, and
+// frees them all at once when destroyed, so it has to outlive any
+// execution of its statements. Token text still points into the source the
+// script was lexed from.
+struct Program {
+	Arena arena;
+	ConstantPool constants;
+	std::vector<Stmt*> statements;
+	// Token index one past the end of each statement, the next one starts there
+	std::vector<size_t> statementEnds;
+	// Buffer the statements were parsed from, empty when streamed or loaded
+	// from a cache. Needed to reparse after an edit.
+	std::vector<Token> tokens;
+	// Pieces parsed on their own, each owning the nodes of some of the
+	// statements
+	std::vector<std::unique_ptr<Program>> parts;
+	// Cache file the token text points into, when loaded by ProgramCache
+	std::unique_ptr<MappedFile> cacheFile;
+	// Syntax errors the Parser reported, in this Program and its parts
+	size_t errors = 0;
+};
@@ -0,0 +1,487 @@
+#pragma once
+#include "pch.h"
+#include "MappedFile.h"
+#include "Program.h"
+#include "Parser.h"
+
+
+// Parsed programs saved next to their script, so later runs of an unchanged
+// script skip lexing and parsing. Only used when asked for, see main. A cache file is only used when it was
+// written for the same source bytes by the same Version of the format.
+//
+// Layout, in native byte order:
+//	Header
+//	string table: stringCount times (length, bytes)
+//	statementCount statements, each node a one byte tag followed by its
+//	fields and children in order. Tokens are a type byte and a string index.
+// Counts and string indices are stored as LEB128 varints. The header holds a
+// hash of everything after it, so damaged files are rejected.
+//
+// A loaded Program keeps the file mapped, its token text points into the
+// string table.
+class ProgramCache {
+public:
+	// Bump whenever the AST or the layout changes
+	static constexpr uint32_t Version = 1;
+
+	ProgramCache(fs::path scriptPath)
+		: path(scriptPath.string() + ".cache") {}
+
+	// FNV-1a taken 8 bytes at a time, with a shift after each step so the
+	// high bits of a word reach the low bits of the hash
+	static uint64_t hash(std::string_view data) {
+		constexpr uint64_t Prime = 1099511628211ull;
+		uint64_t value = 14695981039346656037ull;
+		size_t i = 0;
+		for (; i + 8 <= data.size(); i += 8) {
+			uint64_t word;
+			std::memcpy(&word, data.data() + i, sizeof(word));
+			value = (value ^ word) * Prime;
+			value ^= value >> 29;
+		}
+		for (; i < data.size(); i++) {
+			value = (value ^ (uint8_t)data[i]) * Prime;
+		}
+		return value;
+	}
+
+	// The program parsed from `source` by an earlier run, or nullptr
+	std::unique_ptr<Program> load(std::string_view source) {
+		std::error_code error;
+		if (!fs::is_regular_file(path, error)) {
+			INFO("No program cache at {}", path.string());
+			return nullptr;
+		}
+
+		auto file = std::make_unique<MappedFile>(path);
+		Reader reader{ file->view() };
+		Header header = reader.read<Header>();
+		if (!reader.ok || header.magic != Magic || header.version != Version || header.hash != hash(source)) {
+			INFO("Program cache {} is stale", path.string());
+			return nullptr;
+		}
+
+		if (header.payloadHash != hash(file->view().substr(sizeof(Header)))) {
+			ERR("Corrupt program cache {}", path.string());
+			return nullptr;
+		}
+
+		auto program = std::make_unique<Program>();
+		reader.program = program.get();
+		reader.strings.reserve(std::min<size_t>(header.stringCount, file->view().size()));
+		for (uint32_t i = 0; i < header.stringCount && reader.ok; i++) {
+			uint32_t length = reader.varint();
+			reader.strings.push_back(reader.bytes(length));
+		}
+		reader.symbols.assign(reader.strings.size(), Symbols::None);
+		for (uint32_t i = 0; i < header.statementCount && reader.ok; i++) {
+			program->statements.push_back(reader.stmt());
+		}
+		if (!reader.ok || !reader.atEnd()) {
+			ERR("Corrupt program cache {}", path.string());
+			return nullptr;
+		}
+
+		INFO("Loaded program from cache {}", path.string());
+		program->cacheFile = std::move(file);
+		return program;
+	}
+
+	// Saves `program`, parsed from `source`, for later runs. A program with
+	// syntax errors is left out, a later run has to report them again.
+	void store(std::string_view source, const Program& program) {
+		Writer writer;
+		for (Stmt* stmt : program.statements) {
+			writer.stmt(stmt);
+		}
+		// Checked after writing, which parses the bodies a lazy parse skipped
+		if (program.errors) {
+			INFO("Not caching {}, it has syntax errors", path.string());
+			return;
+		}
+
+		std::string payload;
+		for (std::string_view text : writer.strings) {
+			appendVarint(payload, (uint32_t)text.size());
+			payload.append(text);
+		}
+		payload.append(writer.out);
+		Header header{ Magic, Version, hash(source), hash(payload),
+			(uint32_t)writer.strings.size(), (uint32_t)program.statements.size() };
+
+		// Written aside and renamed over, so readers never see half a file
+		fs::path temp = path;
+		temp += ".tmp";
+		{
+			std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+			out.write((const char*)&header, sizeof(header));
+			out.write(payload.data(), payload.size());
+			if (!out) {
+				ERR("Could not write program cache {}", temp.string());
+				return;
+			}
+		}
+		std::error_code error;
+		fs::rename(temp, path, error);
+		if (error) {
+			ERR("Could not write program cache {}: {}", path.string(), error.message());
+			fs::remove(temp, error);
+			return;
+		}
+		DEB("Wrote program cache {}", path.string());
+	}
+
+private:
+	static constexpr uint32_t Magic = 0x43505950; // "PYPC"
+	// Tag of a missing child, e.g. a bare return
+	static constexpr uint8_t NullTag = 0xFF;
+
+	static void appendVarint(std::string& out, uint32_t value) {
+		while (value >= 0x80) {
+			out.push_back((char)(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back((char)value);
+	}
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t hash;
+		uint64_t payloadHash;
+		uint32_t stringCount;
+		uint32_t statementCount;
+	};
+
+	class Writer {
+	public:
+		std::string out;
+		std::vector<std::string_view> strings;
+
+		void stmt(Stmt* stmt) {
+			if (!stmt) {
+				put<uint8_t>(NullTag);
+				return;
+			}
+			put<uint8_t>((uint8_t)stmt->type);
+			switch (stmt->type) {
+			case StmtType::BLOCK:
+				block((BlockStmt*)stmt);
+				break;
+			case StmtType::EXPRESSION:
+				expr(((ExprStmt*)stmt)->expr);
+				break;
+			case StmtType::PRINT:
+				expr(((PrintStmt*)stmt)->expr);
+				break;
+			case StmtType::IF: {
+				IfStmt* ifStmt = (IfStmt*)stmt;
+				expr(ifStmt->condition);
+				this->stmt(ifStmt->thenStmt);
+				this->stmt(ifStmt->elseStmt);
+				break;
+			}
+			case StmtType::WHILE: {
+				WhileStmt* whileStmt = (WhileStmt*)stmt;
+				expr(whileStmt->condition);
+				this->stmt(whileStmt->main);
+				break;
+			}
+			case StmtType::FUNC_DECL:
+				func((FuncDeclStmt*)stmt);
+				break;
+			case StmtType::RETURN:
+				expr(((ReturnStmt*)stmt)->retVal);
+				break;
+			case StmtType::CLASS_DECL: {
+				ClassDeclStmt* cls = (ClassDeclStmt*)stmt;
+				token(cls->name);
+				appendVarint(out, (uint32_t)cls->methods.size());
+				for (FuncDeclStmt* method : cls->methods) func(method);
+				break;
+			}
+			}
+		}
+
+		void expr(Expr* expr) {
+			if (!expr) {
+				put<uint8_t>(NullTag);
+				return;
+			}
+			put<uint8_t>((uint8_t)expr->type);
+			switch (expr->type) {
+			case ExprType::Literal: {
+				LiteralExpr* literal = (LiteralExpr*)expr;
+				token(literal->token);
+				put<float>(literal->value->value);
+				break;
+			}
+			case ExprType::Identifier:
+				token(((IdentifierExpr*)expr)->token);
+				break;
+			case ExprType::Unary:
+				token(((UnaryExpr*)expr)->oper);
+				this->expr(((UnaryExpr*)expr)->right);
+				break;
+			case ExprType::Binary: {
+				BinaryExpr* binary = (BinaryExpr*)expr;
+				this->expr(binary->left);
+				token(binary->oper);
+				this->expr(binary->right);
+				break;
+			}
+			case ExprType::Assign:
+				this->expr(((AssignExpr*)expr)->left);
+				this->expr(((AssignExpr*)expr)->value);
+				break;
+			case ExprType::FuncCall: {
+				FuncCallExpr* call = (FuncCallExpr*)expr;
+				this->expr(call->name);
+				appendVarint(out, (uint32_t)call->args.size());
+				for (Expr* arg : call->args) this->expr(arg);
+				break;
+			}
+			case ExprType::Get:
+				this->expr(((GetExpr*)expr)->left);
+				token(((GetExpr*)expr)->right);
+				break;
+			}
+		}
+
+	private:
+		void block(BlockStmt* block) {
+			appendVarint(out, (uint32_t)block->stmts.size());
+			for (Stmt* inner : block->stmts) stmt(inner);
+		}
+
+		void func(FuncDeclStmt* func) {
+			token(func->name);
+			appendVarint(out, (uint32_t)func->params.size());
+			for (const Token& param : func->params) token(param);
+			// The cache always holds whole trees
+			block(Parser::body(func));
+		}
+
+		void token(const Token& token) {
+			put<uint8_t>((uint8_t)token.type);
+			appendVarint(out, string(token.value));
+		}
+
+		uint32_t string(std::string_view text) {
+			auto it = stringIds.find(text);
+			if (it != stringIds.end()) return it->second;
+			uint32_t id = (uint32_t)strings.size();
+			strings.push_back(text);
+			stringIds.emplace(text, id);
+			return id;
+		}
+
+		template<typename T>
+		void put(T value) {
+			out.append((const char*)&value, sizeof(T));
+		}
+
+		std::unordered_map<std::string_view, uint32_t> stringIds;
+	};
+
+	// Reads nodes into `program`. Any read past the end or unknown tag
+	// clears `ok`, after which the result must be thrown away.
+	class Reader {
+	public:
+		Reader(std::string_view data)
+			: p(data.data()), end(data.data() + data.size()) {}
+
+		bool ok = true;
+		Program* program = nullptr;
+		std::vector<std::string_view> strings;
+		// Interned on first use, by string index
+		std::vector<Symbol> symbols;
+
+		template<typename T>
+		T read() {
+			T value{};
+			if (!ok || (size_t)(end - p) < sizeof(T)) {
+				ok = false;
+				return value;
+			}
+			std::memcpy(&value, p, sizeof(T));
+			p += sizeof(T);
+			return value;
+		}
+
+		uint32_t varint() {
+			uint32_t value = 0;
+			for (int shift = 0; shift < 35; shift += 7) {
+				uint8_t byte = read<uint8_t>();
+				value |= (uint32_t)(byte & 0x7F) << shift;
+				if (!(byte & 0x80)) return value;
+			}
+			ok = false;
+			return 0;
+		}
+
+		std::string_view bytes(size_t count) {
+			if (!ok || (size_t)(end - p) < count) {
+				ok = false;
+				return {};
+			}
+			std::string_view text{ p, count };
+			p += count;
+			return text;
+		}
+
+		bool atEnd() const {
+			return p == end;
+		}
+
+		Stmt* stmt() {
+			uint8_t tag = read<uint8_t>();
+			if (!ok || tag == NullTag) return nullptr;
+			switch ((StmtType)tag) {
+			case StmtType::BLOCK:
+				return block();
+			case StmtType::EXPRESSION:
+				return make<ExprStmt>(expr());
+			case StmtType::PRINT:
+				return make<PrintStmt>(expr());
+			case StmtType::IF: {
+				Expr* condition = expr();
+				Stmt* thenStmt = stmt();
+				Stmt* elseStmt = stmt();
+				return make<IfStmt>(condition, thenStmt, elseStmt);
+			}
+			case StmtType::WHILE: {
+				Expr* condition = expr();
+				Stmt* mainStmt = stmt();
+				return make<WhileStmt>(condition, mainStmt);
+			}
+			case StmtType::FUNC_DECL:
+				return func();
+			case StmtType::RETURN:
+				return make<ReturnStmt>(expr());
+			case StmtType::CLASS_DECL: {
+				Token name = token();
+				uint32_t count = listSize();
+				size_t base = methodStack.size();
+				for (uint32_t i = 0; i < count && ok; i++) {
+					methodStack.push_back(func());
+				}
+				return make<ClassDeclStmt>(name, finishList(methodStack, base));
+			}
+			}
+			ok = false;
+			return nullptr;
+		}
+
+		Expr* expr() {
+			uint8_t tag = read<uint8_t>();
+			if (!ok || tag == NullTag) return nullptr;
+			switch ((ExprType)tag) {
+			case ExprType::Literal: {
+				Token literal = token();
+				float value = read<float>();
+				return make<LiteralExpr>(literal, program->constants.get(value));
+			}
+			case ExprType::Identifier:
+				return make<IdentifierExpr>(token());
+			case ExprType::Unary: {
+				Token oper = token();
+				Expr* right = expr();
+				return make<UnaryExpr>(oper, right);
+			}
+			case ExprType::Binary: {
+				Expr* left = expr();
+				Token oper = token();
+				Expr* right = expr();
+				return make<BinaryExpr>(left, oper, right);
+			}
+			case ExprType::Assign: {
+				Expr* left = expr();
+				Expr* value = expr();
+				return make<AssignExpr>(left, value);
+			}
+			case ExprType::FuncCall: {
+				Expr* name = expr();
+				uint32_t count = listSize();
+				size_t base = exprStack.size();
+				for (uint32_t i = 0; i < count && ok; i++) {
+					exprStack.push_back(expr());
+				}
+				return make<FuncCallExpr>(name, finishList(exprStack, base));
+			}
+			case ExprType::Get: {
+				Expr* left = expr();
+				return make<GetExpr>(left, token());
+			}
+			}
+			ok = false;
+			return nullptr;
+		}
+
+	private:
+		BlockStmt* block() {
+			uint32_t count = listSize();
+			size_t base = stmtStack.size();
+			for (uint32_t i = 0; i < count && ok; i++) {
+				stmtStack.push_back(stmt());
+			}
+			return make<BlockStmt>(finishList(stmtStack, base));
+		}
+
+		FuncDeclStmt* func() {
+			Token name = token();
+			uint32_t count = listSize();
+			size_t base = paramStack.size();
+			for (uint32_t i = 0; i < count && ok; i++) {
+				paramStack.push_back(token());
+			}
+			NodeList<Token> params = finishList(paramStack, base);
+			BlockStmt* body = block();
+			return make<FuncDeclStmt>(name, params, body);
+		}
+
+		Token token() {
+			Token::Type type = (Token::Type)read<uint8_t>();
+			uint32_t id = varint();
+			if (!ok || id >= strings.size() || type > Token::Type::END) {
+				ok = false;
+				return {};
+			}
+			Token token{ type, strings[id] };
+			if (type == Token::Type::IDENTIFIER) {
+				if (symbols[id] == Symbols::None) symbols[id] = Symbols::intern(token.value);
+				token.symbol = symbols[id];
+			}
+			return token;
+		}
+
+		// Every listed node takes at least a byte, larger counts are corrupt
+		uint32_t listSize() {
+			uint32_t count = varint();
+			if (count > (size_t)(end - p)) ok = false;
+			return ok ? count : 0;
+		}
+
+		template<typename T, typename... Args>
+		T* make(Args&&... args) {
+			return program->arena.make<T>(std::forward<Args>(args)...);
+		}
+
+		template<typename T>
+		NodeList<T> finishList(std::vector<T>& stack, size_t base) {
+			NodeList<T> list = program->arena.list(stack.data() + base, stack.size() - base);
+			stack.resize(base);
+			return list;
+		}
+
+		const char* p;
+		const char* end;
+
+		std::vector<Stmt*> stmtStack;
+		std::vector<Expr*> exprStack;
+		std::vector<Token> paramStack;
+		std::vector<FuncDeclStmt*> methodStack;
+	};
+
+	fs::path path;
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include "pch.h"
+#include "Expression.h"
+#include "Statement.h"
+#include "Program.h"
+#include "Environment.h"
+#include "Visitor.h"
+
+
+// Binds names to where they are stored before running, so the Interpreter
+// reads them without hashing.
+//
+// Scoping is dynamic, so a function body sees whatever its callers bound
+// and only two places are known ahead:
+// - in a function body, its parameters, self and the return value, which
+//   live in slots of the frame of the call
+// - in top level code, the globals, since it runs in the root
+// Other names stay Scope::Dynamic and are looked up through the chain.
+// A slot found unbound, like self outside a method call, is looked up
+// the same way.
+//
+// Bodies still waiting on a lazy parse are resolved by FuncObject::call
+// once parsed.
+class Resolver : public TreeWalker<Resolver> {
+	friend ExprVisitor<Resolver>;
+	friend StmtVisitor<Resolver>;
+public:
+	void run(std::vector<Stmt*>& statements) {
+		visit(statements);
+		INFO("Resolved {} names to frame slots, {} to globals, {} left dynamic", frame, global, dynamic);
+	}
+
+	static void resolve(FuncDeclStmt* func) {
+		Resolver resolver;
+		resolver.function = func;
+		resolver.visit((Stmt*)func->body);
+	}
+
+private:
+	void visitFuncDecl(FuncDeclStmt* func) {
+		const FuncDeclStmt* outer = function;
+		function = func;
+		TreeWalker::visitFuncDecl(func);
+		function = outer;
+	}
+
+	void visitIdentifier(IdentifierExpr* expr) {
+		Symbol name = expr->token.symbol;
+		if (!function) {
+			expr->scope = Scope::Global;
+			expr->slot = name;
+			global++;
+			return;
+		}
+		NodeList<const Token> params{ function->params.items, function->params.count };
+		size_t slot = Environment::slotOf(params, name);
+		if (slot == Environment::None) {
+			expr->scope = Scope::Dynamic;
+			dynamic++;
+			return;
+		}
+		expr->scope = Scope::Frame;
+		expr->slot = (uint32_t)slot;
+		frame++;
+	}
+
+	// The innermost function being visited, null at the top level
+	const FuncDeclStmt* function = nullptr;
+	size_t frame = 0;
+	size_t global = 0;
+	size_t dynamic = 0;
+};
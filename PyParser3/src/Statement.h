@@ -3,9 +3,11 @@
 #include "Lexer.h"
 #include "Expression.h"
 
+struct Program;
+
 // Statements
 
-enum class StmtType {
+enum class StmtType : uint8_t {
 	BLOCK,
 	EXPRESSION,
 	PRINT,
@@ -23,8 +25,8 @@ struct Stmt {
 };
 
 struct BlockStmt : public Stmt {
-	std::vector<Stmt*> stmts;
-	BlockStmt(std::vector<Stmt*> _stmts) {
+	NodeList<Stmt*> stmts;
+	BlockStmt(NodeList<Stmt*> _stmts) {
 		type = StmtType::BLOCK;
 		stmts = _stmts;
 	}
@@ -68,15 +70,27 @@ struct WhileStmt : public Stmt {
 	}
 };
 
+// Function body skipped by a lazy parse, parsed by Parser::body. Runs
+// from after the opening brace to past the matching closing one in
+// `program`'s tokens.
+struct LazyBody {
+	Program* program;
+	size_t start;
+	size_t end;
+};
+
 struct FuncDeclStmt : public Stmt {
 	Token name;
-	std::vector<Token> params;
+	NodeList<Token> params;
+	// Null while the body is lazy
 	BlockStmt* body;
-	FuncDeclStmt(Token _name, std::vector<Token> _params, BlockStmt* _body) {
+	LazyBody* lazy;
+	FuncDeclStmt(Token _name, NodeList<Token> _params, BlockStmt* _body, LazyBody* _lazy = nullptr) {
 		type = StmtType::FUNC_DECL;
 		name = _name;
 		params = _params;
 		body = _body;
+		lazy = _lazy;
 	}
 };
 
@@ -90,8 +104,8 @@ struct ReturnStmt : public Stmt {
 
 struct ClassDeclStmt : public Stmt {
 	Token name;
-	std::vector<FuncDeclStmt*> methods;
-	ClassDeclStmt(Token _name, std::vector<FuncDeclStmt*> _methods) {
+	NodeList<FuncDeclStmt*> methods;
+	ClassDeclStmt(Token _name, NodeList<FuncDeclStmt*> _methods) {
 		type = StmtType::CLASS_DECL;
 		name = _name;
 		methods = _methods;
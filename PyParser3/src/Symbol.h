@@ -0,0 +1,71 @@
+#pragma once
+#include "pch.h"
+
+
+// Interned name. Every distinct identifier gets one id for the lifetime of
+// the process, so names compare and hash as integers. Safe to use from
+// several lexer threads at once.
+using Symbol = uint32_t;
+
+class Symbols {
+public:
+	// Names the interpreter refers to itself, interned up front in this order
+	static constexpr Symbol Retval = 0;
+	static constexpr Symbol Self = 1;
+	static constexpr Symbol Init = 2;
+
+	// Tokens that aren't names
+	static constexpr Symbol None = ~(Symbol)0;
+
+	static Symbol intern(std::string_view name) {
+		Table& table = get();
+		{
+			std::shared_lock<std::shared_mutex> lock(table.mutex);
+			auto it = table.ids.find(name);
+			if (it != table.ids.end()) return it->second;
+		}
+		std::unique_lock<std::shared_mutex> lock(table.mutex);
+		// Another thread may have added it in between
+		auto it = table.ids.find(name);
+		if (it != table.ids.end()) return it->second;
+		return table.add(name);
+	}
+
+	static std::string_view name(Symbol symbol) {
+		if (symbol == None) return "<none>";
+		Table& table = get();
+		std::shared_lock<std::shared_mutex> lock(table.mutex);
+		return table.names[symbol];
+	}
+
+	static size_t count() {
+		Table& table = get();
+		std::shared_lock<std::shared_mutex> lock(table.mutex);
+		return table.names.size();
+	}
+
+private:
+	struct Table {
+		std::unordered_map<std::string_view, Symbol> ids;
+		std::deque<std::string> names;
+		std::shared_mutex mutex;
+
+		Table() {
+			add("__retval__");
+			add("self");
+			add("init");
+		}
+
+		Symbol add(std::string_view name) {
+			Symbol symbol = (Symbol)names.size();
+			// The deque never moves its strings, so the key view stays valid
+			ids.emplace(names.emplace_back(name), symbol);
+			return symbol;
+		}
+	};
+
+	static Table& get() {
+		static Table table;
+		return table;
+	}
+};
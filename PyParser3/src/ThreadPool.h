@@ -0,0 +1,70 @@
+#pragma once
+#include "pch.h"
+
+
+// Fixed set of worker threads running submitted jobs in FIFO order.
+// Jobs must not wait on other jobs of the same pool.
+class ThreadPool {
+public:
+	ThreadPool(size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			workers.emplace_back([this] { work(); });
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers) worker.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	template<typename F>
+	auto submit(F task) -> std::future<decltype(task())> {
+		using R = decltype(task());
+		auto job = std::make_shared<std::packaged_task<R()>>(std::move(task));
+		std::future<R> result = job->get_future();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back([job] { (*job)(); });
+		}
+		wake.notify_one();
+		return result;
+	}
+
+	size_t size() const {
+		return workers.size();
+	}
+
+	// Process-wide pool with one worker per hardware thread
+	static ThreadPool& shared() {
+		static ThreadPool pool{ std::max(1u, std::thread::hardware_concurrency()) };
+		return pool;
+	}
+
+private:
+	void work() {
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+				if (jobs.empty()) return;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			job();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include "pch.h"
+#include "Symbol.h"
+
+
+struct Token {
+	enum class Type : uint8_t {
+		INTEGER,
+		IDENTIFIER,
+
+		PLUS,
+		MINUS,
+		STAR,
+		DIV,
+
+		BANG,
+		BANG_EQUAL,
+		EQUAL_EQUAL,
+		LESS,
+		LESS_EQUAL,
+		GREAT,
+		GREAT_EQUAL,
+
+		EQUAL,
+
+		L_PAREN,
+		R_PAREN,
+		L_BRACE,
+		R_BRACE,
+
+		//Keywords
+		VAR,
+		PRINT,
+		IF,
+		ELSE,
+		WHILE,
+		FUN,
+		RETURN,
+		CLASS,
+		SELF,
+
+		SEMICOLON,
+		COMMA,
+		DOT,
+
+		END
+
+	};
+	Token::Type type;
+	// The lexeme, viewing into the lexer's source buffer. Its position there
+	// is the token's offset; END is an empty view at the end of the source.
+	std::string_view value;
+	// Interned name of identifiers
+	Symbol symbol = Symbols::None;
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include "pch.h"
+#include "Lexer.h"
+
+
+// Tokens as seen by the Parser.
+// Either walks a token buffer lexed up front, or pulls tokens from a Lexer
+// on demand and only keeps a small window of them. The grammar never looks
+// further back than peek(-1) or further ahead than peek(0), so the window
+// stays tiny no matter how large the source is.
+class TokenStream {
+public:
+	TokenStream(std::vector<Token> _tokens)
+		: tokens(std::move(_tokens)) {}
+
+	TokenStream(Lexer* _lexer)
+		: lexer(_lexer) {}
+
+	const Token& peek(int offset) {
+		if (!lexer) return tokens[idx + offset];
+
+		assert(offset >= -1 && offset < (int)WindowSize - 1 && (offset >= 0 || idx > 0));
+		size_t pos = idx + offset;
+		while (pulled <= pos) {
+			window[pulled & WindowMask] = lexer->nextToken();
+			pulled++;
+		}
+		return window[pos & WindowMask];
+	}
+
+	const Token& advance() {
+		const Token& token = peek(0);
+		idx++;
+		return token;
+	}
+
+	size_t position() const {
+		return idx;
+	}
+
+	// Whole token buffer, empty in stream mode
+	const std::vector<Token>& buffer() const {
+		return tokens;
+	}
+
+	std::vector<Token> takeBuffer() {
+		return std::move(tokens);
+	}
+
+	// Batch mode only
+	void seek(size_t position) {
+		idx = position;
+	}
+
+private:
+	// One token behind plus lookahead, kept a power of two
+	static constexpr size_t WindowSize = 4;
+	static constexpr size_t WindowMask = WindowSize - 1;
+
+	size_t idx = 0;
+
+	// Batch mode
+	std::vector<Token> tokens;
+
+	// Stream mode
+	Lexer* lexer = nullptr;
+	std::array<Token, WindowSize> window{};
+	size_t pulled = 0;
+};
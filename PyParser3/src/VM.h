@@ -0,0 +1,269 @@
+#pragma once
+#include "pch.h"
+#include "Object.h"
+#include "Environment.h"
+#include "Bytecode.h"
+#include "Interpreter.h"
+
+// Dispatch jumps straight from one instruction to the next through a table
+// of label addresses where the compiler supports it, a switch otherwise
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_COMPUTED_GOTO 1
+#else
+#define VM_COMPUTED_GOTO 0
+#endif
+
+
+// Runs the Chunks the Compiler makes, over the same Objects and
+// Environments as the Interpreter, with an operand stack in place of the
+// recursion over expressions. Function bodies are compiled on their first
+// call.
+class VM {
+public:
+	static constexpr size_t StackSize = 1 << 16;
+
+	VM()
+		: stack(StackSize) {
+		env = new Environment{ nullptr };
+		top = stack.data();
+	}
+
+	void execute(const std::vector<Stmt*>& statements) {
+		INFO("Starting Execution");
+		std::unique_ptr<Chunk> chunk = Compiler::compile(statements);
+		run(*chunk);
+	}
+
+	Environment* env;
+
+private:
+	void run(Chunk& chunk) {
+		if (top + chunk.maxStack > stack.data() + stack.size()) {
+			ERR("Stack overflow");
+			return;
+		}
+		const uint8_t* code = chunk.code.data();
+		const uint8_t* ip = code;
+		Object** sp = top;
+
+#define READ32() (ip += sizeof(uint32_t), chunk.operand(ip - code - sizeof(uint32_t)))
+#define BINARY(expression) { \
+			float right = number(*--sp); \
+			float left = number(sp[-1]); \
+			sp[-1] = new FloatObject{ expression }; \
+			NEXT(); }
+
+#if VM_COMPUTED_GOTO
+#define BYTECODE_LABEL(name) &&op_##name,
+		static void* const labels[] = { BYTECODE_OPS(BYTECODE_LABEL) };
+#undef BYTECODE_LABEL
+#define NEXT() goto *labels[*ip++]
+#define CASE(name) op_##name:
+		NEXT();
+#else
+#define NEXT() break
+#define CASE(name) case OpCode::name:
+		for (;;) switch ((OpCode)*ip++) {
+#endif
+
+		CASE(Const) {
+			*sp++ = chunk.constants[READ32()];
+			NEXT();
+		}
+		CASE(Nil) {
+			*sp++ = new NilObject{};
+			NEXT();
+		}
+		CASE(LoadSlot) {
+			uint32_t slot = READ32();
+			Symbol name = READ32();
+			Object* value = env->slots[slot];
+			*sp++ = value ? value : env->getValue(name);
+			NEXT();
+		}
+		CASE(LoadGlobal) {
+			Symbol name = READ32();
+			Object* value = name < env->globals.size() ? env->globals[name] : nullptr;
+			*sp++ = value ? value : env->getValue(name);
+			NEXT();
+		}
+		CASE(LoadName) {
+			*sp++ = env->getValue(READ32());
+			NEXT();
+		}
+		CASE(StoreSlot) {
+			uint32_t slot = READ32();
+			Symbol name = READ32();
+			Object*& value = env->slots[slot];
+			if (value) value = sp[-1];
+			else *env->getRef(name).obj = sp[-1];
+			NEXT();
+		}
+		CASE(StoreGlobal) {
+			Symbol name = READ32();
+			if (name < env->globals.size() && env->globals[name]) env->globals[name] = sp[-1];
+			else *env->getRef(name).obj = sp[-1];
+			NEXT();
+		}
+		CASE(StoreName) {
+			*env->getRef(READ32()).obj = sp[-1];
+			NEXT();
+		}
+		CASE(GetAttr) {
+			sp[-1] = sp[-1]->getAttr(READ32());
+			NEXT();
+		}
+		CASE(SetAttr) {
+			Object* object = *--sp;
+			ObjRef ref = object->getAttrRef(READ32());
+			if (ref.obj) *ref.obj = sp[-1];
+			NEXT();
+		}
+		CASE(Add) BINARY(left + right)
+		CASE(Sub) BINARY(left - right)
+		CASE(Mul) BINARY(left * right)
+		CASE(Div) BINARY(left / right)
+		CASE(Equal) BINARY(left == right ? 1.0f : 0.0f)
+		CASE(NotEqual) BINARY(left != right ? 1.0f : 0.0f)
+		CASE(Less) BINARY(left < right ? 1.0f : 0.0f)
+		CASE(LessEqual) BINARY(left <= right ? 1.0f : 0.0f)
+		CASE(Greater) BINARY(left > right ? 1.0f : 0.0f)
+		CASE(GreaterEqual) BINARY(left >= right ? 1.0f : 0.0f)
+		CASE(Binary) {
+			Token::Type oper = (Token::Type)READ32();
+			BINARY(Interpreter::apply(oper, left, right))
+		}
+		CASE(Negate) {
+			sp[-1] = new FloatObject{ -number(sp[-1]) };
+			NEXT();
+		}
+		CASE(Not) {
+			sp[-1] = new FloatObject{ number(sp[-1]) == 0 ? 1.0f : 0.0f };
+			NEXT();
+		}
+		CASE(Call) {
+			uint32_t count = READ32();
+			Object* callee = *--sp;
+			sp -= count;
+			// The callee's stack starts above the arguments
+			top = sp + count;
+			Object* result = call(callee, sp, count);
+			top = sp;
+			*sp++ = result;
+			NEXT();
+		}
+		CASE(Pop) {
+			--sp;
+			NEXT();
+		}
+		CASE(Print) {
+			std::cout << number(*--sp) << std::endl;
+			NEXT();
+		}
+		CASE(Jump) {
+			ip = code + chunk.operand(ip - code);
+			NEXT();
+		}
+		CASE(JumpIfFalse) {
+			uint32_t target = READ32();
+			if (!number(*--sp)) ip = code + target;
+			NEXT();
+		}
+		CASE(JumpIfDead) {
+			uint32_t target = READ32();
+			if (env->isDead) ip = code + target;
+			NEXT();
+		}
+		CASE(Function) {
+			*sp++ = new FuncObject{ (FuncDeclStmt*)chunk.decls[READ32()] };
+			NEXT();
+		}
+		CASE(Class) {
+			ClassDeclStmt* decl = (ClassDeclStmt*)chunk.decls[READ32()];
+			ClassObject* cls = new ClassObject{};
+			for (FuncDeclStmt* method : decl->methods) {
+				cls->addMethod(method->name.symbol, new FuncObject{ method });
+			}
+			*sp++ = cls;
+			NEXT();
+		}
+		CASE(Define) {
+			env->setValue(READ32(), *--sp);
+			NEXT();
+		}
+		CASE(Return) {
+			env->setValueForce(Symbols::Retval, *--sp);
+			env->isDead = true;
+			NEXT();
+		}
+		CASE(End) {
+			return;
+		}
+
+#if !VM_COMPUTED_GOTO
+		}
+#endif
+#undef CASE
+#undef NEXT
+#undef BINARY
+#undef READ32
+	}
+
+	// Calls `callee` the way its Object::call would
+	Object* call(Object* callee, Object** args, size_t count) {
+		if (!callee) {
+			ERR("Illegal call");
+			return nullptr;
+		}
+		switch (callee->getType()) {
+		case Object::Type::FUNC:
+			return invoke((FuncObject*)callee, args, count);
+		case Object::Type::CLASS: {
+			ObjObject* obj = new ObjObject{ (ClassObject*)callee };
+			Object* init = obj->getAttr(Symbols::Init);
+			if (init) call(init, args, count);
+			return obj;
+		}
+		default:
+			ERR("Illegal call");
+			return nullptr;
+		}
+	}
+
+	Object* invoke(FuncObject* func, Object** args, size_t count) {
+		if (func->params.size() != count) {
+			ERR("Argument length not matching");
+		}
+		Chunk* body = compiled(func->decl);
+		Environment* frame = new Environment{ env, func->params };
+		for (size_t i = 0; i < func->params.size() && i < count; i++) {
+			frame->slots[2 + i] = args[i];
+		}
+		frame->slots[Environment::SelfSlot] = func->binding;
+		frame->slots[Environment::RetvalSlot] = new NilObject{};
+
+		env = frame;
+		run(*body);
+		env = frame->parent;
+		return frame->slots[Environment::RetvalSlot];
+	}
+
+	// The code of a function, compiled once however many times it is declared
+	Chunk* compiled(FuncDeclStmt* decl) {
+		std::unique_ptr<Chunk>& chunk = functions[decl];
+		if (!chunk) chunk = Compiler::compile(decl);
+		return chunk.get();
+	}
+
+	static float number(Object* value) {
+		if (value->getType() == Object::Type::FLOAT) {
+			return ((FloatObject*)value)->value;
+		}
+		return 0;
+	}
+
+	std::unordered_map<FuncDeclStmt*, std::unique_ptr<Chunk>> functions;
+	std::vector<Object*> stack;
+	// Where the running chunk's part of the stack starts
+	Object** top;
+};
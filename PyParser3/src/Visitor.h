@@ -0,0 +1,287 @@
+#pragma once
+#include "pch.h"
+#include "Expression.h"
+#include "Statement.h"
+
+
+// Static dispatch over the node types. A pass derives from these with
+// itself as `Derived` and defines a visit function per node type, which
+// visit() calls for the node's type tag. There are no virtual calls, so
+// the dispatch and the visit functions can be inlined.
+//
+// Visit functions may be private if the pass befriends the visitor.
+
+template<typename Derived, typename R = void>
+class ExprVisitor {
+public:
+	R visit(Expr* expr) {
+		Derived& pass = static_cast<Derived&>(*this);
+		switch (expr->type) {
+		case ExprType::Literal:
+			return pass.visitLiteral((LiteralExpr*)expr);
+		case ExprType::Identifier:
+			return pass.visitIdentifier((IdentifierExpr*)expr);
+		case ExprType::Unary:
+			return pass.visitUnary((UnaryExpr*)expr);
+		case ExprType::Binary:
+			return pass.visitBinary((BinaryExpr*)expr);
+		case ExprType::Assign:
+			return pass.visitAssign((AssignExpr*)expr);
+		case ExprType::FuncCall:
+			return pass.visitFuncCall((FuncCallExpr*)expr);
+		case ExprType::Get:
+			return pass.visitGet((GetExpr*)expr);
+		}
+		ERR("Unknown Expr Type:");
+		return R();
+	}
+};
+
+template<typename Derived, typename R = void>
+class StmtVisitor {
+public:
+	R visit(Stmt* stmt) {
+		Derived& pass = static_cast<Derived&>(*this);
+		switch (stmt->type) {
+		case StmtType::BLOCK:
+			return pass.visitBlock((BlockStmt*)stmt);
+		case StmtType::EXPRESSION:
+			return pass.visitExpression((ExprStmt*)stmt);
+		case StmtType::PRINT:
+			return pass.visitPrint((PrintStmt*)stmt);
+		case StmtType::IF:
+			return pass.visitIf((IfStmt*)stmt);
+		case StmtType::WHILE:
+			return pass.visitWhile((WhileStmt*)stmt);
+		case StmtType::FUNC_DECL:
+			return pass.visitFuncDecl((FuncDeclStmt*)stmt);
+		case StmtType::RETURN:
+			return pass.visitReturn((ReturnStmt*)stmt);
+		case StmtType::CLASS_DECL:
+			return pass.visitClassDecl((ClassDeclStmt*)stmt);
+		}
+		ERR("Unknown Stmt Type:");
+		return R();
+	}
+};
+
+
+// Visits every node of a tree. Each default visits the children of its
+// node, so a pass only defines the functions for the nodes it cares about
+// and calls the default from them to keep going below. Null children are
+// skipped, as are bodies still waiting on a lazy parse.
+template<typename Derived>
+class TreeWalker : public ExprVisitor<Derived>, public StmtVisitor<Derived> {
+public:
+	void visit(Expr* expr) {
+		if (expr) ExprVisitor<Derived>::visit(expr);
+	}
+
+	void visit(Stmt* stmt) {
+		if (stmt) StmtVisitor<Derived>::visit(stmt);
+	}
+
+	void visit(const std::vector<Stmt*>& statements) {
+		for (Stmt* stmt : statements) pass().visit(stmt);
+	}
+
+	void visitLiteral(LiteralExpr*) {}
+
+	void visitIdentifier(IdentifierExpr*) {}
+
+	void visitUnary(UnaryExpr* expr) {
+		pass().visit(expr->right);
+	}
+
+	void visitBinary(BinaryExpr* expr) {
+		pass().visit(expr->left);
+		pass().visit(expr->right);
+	}
+
+	void visitAssign(AssignExpr* expr) {
+		pass().visit(expr->left);
+		pass().visit(expr->value);
+	}
+
+	void visitFuncCall(FuncCallExpr* expr) {
+		pass().visit(expr->name);
+		for (Expr* arg : expr->args) pass().visit(arg);
+	}
+
+	void visitGet(GetExpr* expr) {
+		pass().visit(expr->left);
+	}
+
+	void visitBlock(BlockStmt* stmt) {
+		for (Stmt* inner : stmt->stmts) pass().visit(inner);
+	}
+
+	void visitExpression(ExprStmt* stmt) {
+		pass().visit(stmt->expr);
+	}
+
+	void visitPrint(PrintStmt* stmt) {
+		pass().visit(stmt->expr);
+	}
+
+	void visitIf(IfStmt* stmt) {
+		pass().visit(stmt->condition);
+		pass().visit(stmt->thenStmt);
+		pass().visit(stmt->elseStmt);
+	}
+
+	void visitWhile(WhileStmt* stmt) {
+		pass().visit(stmt->condition);
+		pass().visit(stmt->main);
+	}
+
+	void visitFuncDecl(FuncDeclStmt* stmt) {
+		pass().visit((Stmt*)stmt->body);
+	}
+
+	void visitReturn(ReturnStmt* stmt) {
+		pass().visit(stmt->retVal);
+	}
+
+	void visitClassDecl(ClassDeclStmt* stmt) {
+		for (FuncDeclStmt* method : stmt->methods) pass().visit((Stmt*)method);
+	}
+
+private:
+	Derived& pass() {
+		return static_cast<Derived&>(*this);
+	}
+};
+
+
+// Like TreeWalker, but every visit returns what takes the place of the
+// node visited, so a pass can replace nodes. The defaults put back what
+// visiting each child returned and keep the node itself. Function bodies
+// and methods are rewritten in place, what visiting them returns is not
+// used.
+template<typename Derived>
+class TreeRewriter : public ExprVisitor<Derived, Expr*>, public StmtVisitor<Derived, Stmt*> {
+public:
+	Expr* visit(Expr* expr) {
+		return expr ? ExprVisitor<Derived, Expr*>::visit(expr) : nullptr;
+	}
+
+	Stmt* visit(Stmt* stmt) {
+		return stmt ? StmtVisitor<Derived, Stmt*>::visit(stmt) : nullptr;
+	}
+
+	void visit(std::vector<Stmt*>& statements) {
+		for (Stmt*& stmt : statements) stmt = pass().visit(stmt);
+	}
+
+	Expr* visitLiteral(LiteralExpr* expr) {
+		return expr;
+	}
+
+	Expr* visitIdentifier(IdentifierExpr* expr) {
+		return expr;
+	}
+
+	Expr* visitUnary(UnaryExpr* expr) {
+		expr->right = pass().visit(expr->right);
+		return expr;
+	}
+
+	Expr* visitBinary(BinaryExpr* expr) {
+		expr->left = pass().visit(expr->left);
+		expr->right = pass().visit(expr->right);
+		return expr;
+	}
+
+	Expr* visitAssign(AssignExpr* expr) {
+		expr->left = pass().visit(expr->left);
+		expr->value = pass().visit(expr->value);
+		return expr;
+	}
+
+	Expr* visitFuncCall(FuncCallExpr* expr) {
+		expr->name = pass().visit(expr->name);
+		for (Expr*& arg : expr->args) arg = pass().visit(arg);
+		return expr;
+	}
+
+	Expr* visitGet(GetExpr* expr) {
+		expr->left = pass().visit(expr->left);
+		return expr;
+	}
+
+	Stmt* visitBlock(BlockStmt* stmt) {
+		for (Stmt*& inner : stmt->stmts) inner = pass().visit(inner);
+		return stmt;
+	}
+
+	Stmt* visitExpression(ExprStmt* stmt) {
+		stmt->expr = pass().visit(stmt->expr);
+		return stmt;
+	}
+
+	Stmt* visitPrint(PrintStmt* stmt) {
+		stmt->expr = pass().visit(stmt->expr);
+		return stmt;
+	}
+
+	Stmt* visitIf(IfStmt* stmt) {
+		stmt->condition = pass().visit(stmt->condition);
+		stmt->thenStmt = pass().visit(stmt->thenStmt);
+		stmt->elseStmt = pass().visit(stmt->elseStmt);
+		return stmt;
+	}
+
+	Stmt* visitWhile(WhileStmt* stmt) {
+		stmt->condition = pass().visit(stmt->condition);
+		stmt->main = pass().visit(stmt->main);
+		return stmt;
+	}
+
+	Stmt* visitFuncDecl(FuncDeclStmt* stmt) {
+		pass().visit((Stmt*)stmt->body);
+		return stmt;
+	}
+
+	Stmt* visitReturn(ReturnStmt* stmt) {
+		stmt->retVal = pass().visit(stmt->retVal);
+		return stmt;
+	}
+
+	Stmt* visitClassDecl(ClassDeclStmt* stmt) {
+		for (FuncDeclStmt* method : stmt->methods) pass().visit((Stmt*)method);
+		return stmt;
+	}
+
+private:
+	Derived& pass() {
+		return static_cast<Derived&>(*this);
+	}
+};
+
+
+// Number of nodes in a tree
+class NodeCounter : public TreeWalker<NodeCounter> {
+public:
+	template<typename Node>
+	static size_t count(Node* node) {
+		NodeCounter counter;
+		counter.visit(node);
+		return counter.nodes;
+	}
+
+	void visit(Expr* expr) {
+		if (!expr) return;
+		nodes++;
+		TreeWalker::visit(expr);
+	}
+
+	void visit(Stmt* stmt) {
+		if (!stmt) return;
+		nodes++;
+		TreeWalker::visit(stmt);
+	}
+
+private:
+	size_t nodes = 0;
+};
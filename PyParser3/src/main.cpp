@@ -2,6 +2,12 @@
 #include "Lexer.h"
 #include "Parser.h"
 #include "Interpreter.h"
+#include "ProgramCache.h"
+#include "Optimizer.h"
+#include "Resolver.h"
+#include "VM.h"
+#include "ClosureCompiler.h"
+#include "Jit.h"
 
 
 
@@ -10,12 +16,62 @@ void configLogger() {
 	spdlog::set_level(spdlog::level::info);
 }
 
-int main() {
+// Usage: PyParser3 [--engine=tree|vm|closure] [--jit] [--jit-stats] [--cache] [script]
+// The JIT runs under the tree engine, --jit-stats turns it on as well.
+// --cache keeps the parsed program in <script>.cache for the next run.
+int main(int argc, char** argv) {
 	configLogger();
 	std::string cwd = "C:\\Mayaank\\Programming\\Master\\C++\\PyParser3\\PyParser3\\src\\";
-	Lexer lexer{ cwd + "program.txt" };
-	Parser parser{ lexer.getTokens() };
+	std::string path = cwd + "program.txt";
+	std::string engine = "tree";
+	bool useJit = false;
+	bool jitStats = false;
+	bool useCache = false;
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+		if (arg.substr(0, 9) == "--engine=") engine = arg.substr(9);
+		else if (arg == "--jit") useJit = true;
+		else if (arg == "--jit-stats") useJit = jitStats = true;
+		else if (arg == "--cache") useCache = true;
+		else path = arg;
+	}
+	if (engine != "tree" && engine != "vm" && engine != "closure") {
+		ERR("Unknown engine {}, expected tree, vm or closure", engine);
+		return 1;
+	}
+	if (useJit && engine != "tree") {
+		ERR("The JIT only runs under the tree engine");
+		useJit = jitStats = false;
+	}
+
+	INFO("Reading file : {}", path);
+	MappedFile script{ path };
+	ProgramCache cache{ path };
+	std::unique_ptr<Program> program;
+	if (useCache) program = cache.load(script.view());
+	if (!program) {
+		INFO("Starting Lexing");
+		Lexer lexer = Lexer::fromSource(script.view(), Lexer::Mode::Stream);
+		program = Parser{ lexer }.takeProgram();
+		if (useCache) cache.store(script.view(), *program);
+	}
+	Optimizer{}.run(*program);
+	// After the Optimizer, which adds names of its own
+	Resolver{}.run(program->statements);
+	if (engine == "vm") {
+		VM vm{};
+		vm.execute(program->statements);
+		return 0;
+	}
+	if (engine == "closure") {
+		ClosureCompiler closures{};
+		closures.execute(program->statements);
+		return 0;
+	}
+	Jit jit{};
 	Interpreter interpreter{};
-	interpreter.execute(parser.getStatements());
+	if (useJit) interpreter.jit = &jit;
+	interpreter.execute(program->statements);
+	if (jitStats) jit.dumpStats();
 
 }
@@ -1,7 +1,9 @@
 #pragma once
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <deque>
 #include <array>
 #include <unordered_set>
 #include <algorithm>
@@ -14,6 +16,20 @@
 #include <variant>
 #include <filesystem>
 #include <any>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <cstring>
+#include <charconv>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
 
 
 #include "spdlog/spdlog.h"